@@ -10,124 +10,794 @@
 /// defined in "detectPrimes.h".
 
 #include "detectPrimes.h"
-#include <cmath>
+#include "detectPrimes_stats.h"
 #include <cstdio>
 #include <cstdlib>
 #include <mutex>
 #include <condition_variable>
 #include <iostream>
 #include <atomic> 
+#include <algorithm>
+#include <functional>
+#include <list>
+#include <chrono>
+#include <array>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <unistd.h>
+#include <cctype>
 
 using namespace std;
 
-vector<int64_t> numbers;
-vector<int64_t> result;
-int numOfThreads;
-int64_t num;
-
-int myIndex = 0;
-atomic<bool> isPrimeFinal = true;
-atomic<bool> stop = false;
-atomic<bool> done = false;
-pthread_barrier_t barrier;
-
-// returns true if n is prime, otherwise returns false
-static bool is_prime(int64_t n, int64_t id) {
-  if (!stop.load(memory_order_relaxed)){   
-    if (n < 2) return false;
-    if (n <= 3) return true;      // 2 and 3 are primes
-    if (n % 2 == 0) return false; // handle multiples of 2
-    if (n % 3 == 0) return false; // handle multiples of 3
-
-    // each thread should be dealing with individual divisors
-    int64_t div = 5 + id * 6;
-    int64_t max = sqrt(n);
-    while (div <= max) {
-      if (n % div == 0) return false;
-      if (n % (div + 2) == 0) return false;
-      div = div + numOfThreads * 6;
-    }
-    // didn't find any divisors, so it must be a prime
-    return true;
+// numbers below this are always tested whole by a single thread, larger
+// ones only if they have a small factor
+const int64_t large_limit = int64_t(1) << 32;
+// range of batch sizes handed out to the threads
+const size_t min_batch = 16;
+const size_t max_batch = 4096;
+
+// sieve of the numbers below sieve_limit, built on the first call and then
+// shared by all calls; bit k of sieveBits is set if 2k+1 is composite
+const int64_t sieve_limit = int64_t(1) << 20;
+vector<uint64_t> sieveBits;
+vector<uint64_t> sievePrimes;   // odd primes below sieve_limit
+once_flag sieveOnce;
+
+// a range sieve is built only if it costs at most range_cost bits per input
+const int64_t range_cost = 512;
+const int64_t range_max_bits = int64_t(1) << 27;
+
+// odd primes used for trial division before Miller-Rabin, as a multiple of
+// the block size used by trial_division()
+constexpr int n_small_primes = 64;
+constexpr int division_block = 8;
+static_assert(n_small_primes % division_block == 0, "whole blocks only");
+
+// returns the first N odd primes
+template <size_t N>
+constexpr array<uint64_t, N> first_odd_primes() {
+  array<uint64_t, N> primes {};
+  size_t count = 0;
+  for (uint64_t c = 3; count < N; c += 2) {
+    bool prime = true;
+    for (size_t j = 0; j < count && primes[j] * primes[j] <= c; j++) {
+      if (c % primes[j] == 0) { prime = false; break; }
+    }
+    if (prime) primes[count++] = c;
   }
-  // thread should be cancelled, just return false
-  return false;
+  return primes;
 }
 
-struct Task{
-    int64_t number;
-    bool is_prime;
-    int id;
+// p^-1 mod 2^64 for odd p, by Newton iteration (every step doubles the
+// number of correct bits)
+constexpr uint64_t inverse_mod_2_64(uint64_t p) {
+  uint64_t inv = p;
+  for (int i = 0; i < 5; i++) inv *= 2 - p * inv;
+  return inv;
+}
+
+// for odd p, n is divisible by p exactly when n * p^-1 mod 2^64 is at most
+// (2^64 - 1) / p, so a division becomes a multiplication and a comparison
+template <size_t N>
+constexpr array<uint64_t, N> inverses(const array<uint64_t, N> & primes) {
+  array<uint64_t, N> result {};
+  for (size_t i = 0; i < N; i++) result[i] = inverse_mod_2_64(primes[i]);
+  return result;
+}
+template <size_t N>
+constexpr array<uint64_t, N> quotient_limits(const array<uint64_t, N> & primes) {
+  array<uint64_t, N> result {};
+  for (size_t i = 0; i < N; i++) result[i] = UINT64_MAX / primes[i];
+  return result;
+}
+
+// one more prime than used for trial division, it gives the limit below
+constexpr auto small_primes = first_odd_primes<n_small_primes + 1>();
+constexpr auto small_inverses = inverses(small_primes);
+constexpr auto small_limits = quotient_limits(small_primes);
+// any n below this that survived trial division is a prime
+constexpr uint64_t small_primes_limit = small_primes[n_small_primes] * small_primes[n_small_primes];
+
+// Miller-Rabin witnesses that are deterministic for every 64-bit n
+// - bases found by Jim Sinclair, see https://miller-rabin.appspot.com/
+static const uint64_t mr_bases[] = {
+  2, 325, 9375, 28178, 450775, 9780504, 1795265022
+};
+static const int n_mr_bases = sizeof(mr_bases) / sizeof(mr_bases[0]);
+
+// threads sharing a large candidate poll its cancel flag once every
+// cancel_chunk Montgomery multiplications
+const int cancel_chunk = 16;
+
+// the work one thread does on the large candidates it shares with the other
+// threads; lets it give up early once another thread has found the candidate
+// to be composite, and counts the work for the statistics
+struct SharedWork {
+  const atomic<bool> * cancel = nullptr;
+  int64_t mulmods = 0;     // Montgomery multiplications done
+  int64_t wasted = 0;      // work done after the candidate was cancelled
+  int since_poll = 0;
+
+  // counts one unit of work, returns true if the candidate was cancelled
+  // - all work since the last poll is counted as wasted, since the flag
+  //   could have been raised any time during that chunk
+  bool poll() {
+    if (++since_poll < cancel_chunk) return false;
+    bool cancelled = cancel->load(memory_order_relaxed);
+    if (cancelled) wasted += since_poll;
+    since_poll = 0;
+    return cancelled;
+  }
+  // called when this thread finished its share without finding a witness;
+  // the work since the last poll is wasted if another thread has found one
+  void finish() {
+    if (cancel->load(memory_order_relaxed)) wasted += since_poll;
+    since_poll = 0;
+  }
 };
 
-void * thread_task(void * args){
-  struct Task * in = ((struct Task *) args);
-  int id = in->id;
+// arithmetic modulo an odd n in Montgomery form (R = 2^64), so that the
+// modular multiplications in Miller-Rabin need no hardware division
+struct Montgomery {
+  uint64_t n;
+  uint64_t n_inv;  // n^-1 mod 2^64
+  uint64_t r2;     // R^2 mod n
 
-  int flag;
-  int sizenums = numbers.size();
+  explicit Montgomery(uint64_t n) : n(n) {
+    // Newton iteration, every step doubles the number of correct bits
+    n_inv = n;
+    for (int i = 0; i < 5; i++) n_inv *= 2 - n * n_inv;
+    r2 = uint64_t(-__uint128_t(n) % n);
+  }
+  // returns t / R mod n, for t < n * R
+  uint64_t reduce(__uint128_t t) const {
+    uint64_t q = uint64_t(t) * n_inv;
+    uint64_t h = (__uint128_t(q) * n) >> 64;
+    uint64_t a = t >> 64;
+    return a >= h ? a - h : a - h + n;
+  }
+  uint64_t mul(uint64_t a, uint64_t b) const { return reduce(__uint128_t(a) * b); }
+  uint64_t to_mont(uint64_t a) const { return mul(a % n, r2); }
+  uint64_t one() const { return to_mont(1); }
+};
 
-  while(1){
-    isPrimeFinal = true; // re-initialize this variable for every number
+// one round of Miller-Rabin with witness a, where n - 1 = d * 2^s
+// returns false if a proves that n is composite, or if the shared work (if
+// given) was cancelled
+static bool mr_round(const Montgomery & m, uint64_t a, uint64_t d, int s,
+                     SharedWork * work) {
+  uint64_t one = m.one();
+  uint64_t minus_one = m.n - one;
+  uint64_t base = m.to_mont(a);
+  if (base == 0) return true;   // a is a multiple of n, says nothing
 
-    // serial task
-    flag = pthread_barrier_wait(&barrier);
-    if(flag == PTHREAD_BARRIER_SERIAL_THREAD){
-      stop.store(false, memory_order_relaxed);
-      num = numbers[myIndex];
-      if(myIndex >= sizenums){
-        // no more numbers left, set flag 
-        done.store(true, memory_order_relaxed);
-      }
-      myIndex++;  // get next number from nums[] 
+  uint64_t x = one;
+  for (uint64_t e = d; e; e >>= 1) {
+    if (e & 1) x = m.mul(x, base);
+    base = m.mul(base, base);
+    if (work) {
+      work->mulmods++;
+      if (work->poll()) return false;
     }
-    pthread_barrier_wait(&barrier);
-
-    // parallel work 
-    // check if done flag has been set, this means all the numbers have been checked
-    if (done.load(memory_order_relaxed)){
-      pthread_exit(NULL);
+  }
+  if (x == one || x == minus_one) return true;
+  for (int i = 1; i < s; i++) {
+    x = m.mul(x, x);
+    if (x == minus_one) return true;
+    if (x == one) return false;
+    if (work) {
+      work->mulmods++;
+      if (work->poll()) return false;
     }
-    else{
-      // store each number and is_prime results into memory
-      in->number = num;
-      in->is_prime = is_prime(num, id);
+  }
+  return false;
+}
 
-      // ANDing two values to get final evaluation if number is prime.
-      // i.e. if one of in->is_prime is a 0, the evaluation will be 0 
-      //  and we can cancel the other threads.
-      isPrimeFinal = (in->is_prime & isPrimeFinal);
-      if (!isPrimeFinal) stop.store(true, memory_order_relaxed);
+// trial division of n by 2 and the small odd primes
+// returns 0 if n is composite, 1 if n is prime and -1 if it is still unknown
+//
+// the divisibility tests use the precomputed inverses instead of hardware
+// division, and are done a whole block at a time without branches, which
+// lets the compiler keep several of them in flight (or in SIMD lanes where
+// the target has 64-bit vector multiplies)
+static int trial_division(uint64_t n) {
+  if (n < 2) return 0;
+  if (n % 2 == 0) return n == 2;
+  for (int b = 0; b < n_small_primes; b += division_block) {
+    bool divisible = false;
+    for (int i = b; i < b + division_block; i++) {
+      divisible |= n * small_inverses[i] <= small_limits[i];
     }
-
-    // serial work - push results in global array
-    flag = pthread_barrier_wait(&barrier);
-    if(flag == PTHREAD_BARRIER_SERIAL_THREAD){
-      if (isPrimeFinal){
-        result.push_back(in->number);
+    if (divisible) {
+      // n is p itself, or a proper multiple of one of the primes in the block
+      for (int i = b; i < b + division_block; i++) {
+        if (n * small_inverses[i] <= small_limits[i]) return n == small_primes[i];
       }
     }
-    pthread_barrier_wait(&barrier);
   }
+  if (n < small_primes_limit) return 1;
+  return -1;
 }
 
-vector<int64_t> detect_primes(const vector<int64_t> & nums, int n_threads) {
-  pthread_barrier_init(&barrier, NULL ,n_threads);
-  numOfThreads = n_threads;
-  numbers = nums;
+// Miller-Rabin with every step-th witness, starting at index first
+static bool miller_rabin(uint64_t n, int first, int step, SharedWork * work = nullptr) {
+  uint64_t d = n - 1;
+  int s = 0;
+  while ((d & 1) == 0) { d >>= 1; s++; }
+  Montgomery m(n);
+  for (int i = first; i < n_mr_bases; i += step) {
+    if (!mr_round(m, mr_bases[i], d, s, work)) return false;
+  }
+  // no witness for compositeness, so it must be a prime
+  return true;
+}
 
-  pthread_t thread_pool[n_threads];
-  Task tasks[n_threads];            // prepare memory for each thread
+namespace forisek {
+// deterministic single-threaded primality test for any 64-bit x
+bool is_prime(uint64_t x) {
+  int r = trial_division(x);
+  if (r >= 0) return r;
+  return miller_rabin(x, 0, 1);
+}
+};
 
-  // create threads and call the thread_task function
-  for(int i = 0; i < n_threads; i++){
-    tasks[i].id = i;
+struct ParallelTask{
+    int id;
+    int n_threads;
+    const function<void(int, int)> * fn;
+};
+
+static void * parallel_task(void * args){
+  struct ParallelTask * in = ((struct ParallelTask *) args);
+  (*in->fn)(in->id, in->n_threads);
+  return NULL;
+}
+
+// runs fn(id, n_threads) on n_threads threads and waits for all of them
+static void parallel_for(int n_threads, const function<void(int, int)> & fn) {
+  if (n_threads == 1) {
+    fn(0, 1);
+    return;
   }
+  vector<pthread_t> thread_pool(n_threads);
+  vector<ParallelTask> tasks(n_threads);
   for(int i = 0; i < n_threads; i++){
-    pthread_create(&thread_pool[i], NULL, thread_task, (void *) &tasks[i]);
+    tasks[i] = { i, n_threads, &fn };
+    pthread_create(&thread_pool[i], NULL, parallel_task, (void *) &tasks[i]);
   }
-  for(int i=0; i< n_threads; i++){
+  for(int i = 0; i < n_threads; i++){
     pthread_join(thread_pool[i], NULL);
   }
-  return result;
+}
+
+// marks the odd numbers base + 2k, for k_lo <= k < k_hi, that are divisible
+// by one of the given odd primes (other than the prime itself)
+// - k_lo and k_hi are multiples of 64, so threads that mark different
+//   k ranges never write to the same word
+static void mark_composites(vector<uint64_t> & bits, uint64_t base, uint64_t k_lo,
+                            uint64_t k_hi, const vector<uint64_t> & primes) {
+  uint64_t lo = base + 2 * k_lo;
+  uint64_t hi = base + 2 * (k_hi - 1);
+  for (uint64_t p : primes) {
+    if (p * p > hi) break;
+    // first odd multiple of p that is >= lo, but never p itself
+    uint64_t v = std::max(p * p, (lo + p - 1) / p * p);
+    if (v % 2 == 0) v += p;
+    for (; v <= hi; v += 2 * p) {
+      uint64_t k = (v - base) / 2;
+      bits[k >> 6] |= uint64_t(1) << (k & 63);
+    }
+  }
+}
+
+// splits the k range [0, size) into one block of whole words per thread
+static void mark_composites_parallel(vector<uint64_t> & bits, uint64_t base,
+                                     uint64_t size, const vector<uint64_t> & primes,
+                                     int n_threads) {
+  uint64_t words = (size + 63) / 64;
+  parallel_for(n_threads, [&](int id, int nt) {
+    uint64_t w_lo = words * id / nt;
+    uint64_t w_hi = words * (id + 1) / nt;
+    if (w_lo < w_hi) {
+      mark_composites(bits, base, w_lo * 64, std::min(w_hi * 64, size), primes);
+    }
+  });
+}
+
+// builds the shared sieve of small primes, only done on the first call
+static void build_small_sieve(int n_threads) {
+  call_once(sieveOnce, [n_threads]() {
+    // odd primes up to sqrt(sieve_limit) are found serially
+    vector<uint64_t> base_primes;
+    for (uint64_t p = 3; p * p < uint64_t(sieve_limit); p += 2) {
+      bool prime = true;
+      for (uint64_t q : base_primes) {
+        if (q * q > p) break;
+        if (p % q == 0) { prime = false; break; }
+      }
+      if (prime) base_primes.push_back(p);
+    }
+    uint64_t size = sieve_limit / 2;
+    sieveBits.assign((size + 63) / 64, 0);
+    mark_composites_parallel(sieveBits, 1, size, base_primes, n_threads);
+    sieveBits[0] |= 1;   // 1 is not a prime
+    for (uint64_t k = 1; k < size; k++) {
+      if (!(sieveBits[k >> 6] >> (k & 63) & 1)) sievePrimes.push_back(2 * k + 1);
+    }
+  });
+}
+
+// n < sieve_limit
+static bool sieve_is_prime(int64_t n) {
+  if (n % 2 == 0) return n == 2;
+  uint64_t k = n / 2;
+  return !(sieveBits[k >> 6] >> (k & 63) & 1);
+}
+
+// segmented sieve over [base, base + 2 * size), built for the inputs of one
+// call when they fall in a narrow range; bit k is set if base + 2k has a
+// factor below sieve_limit
+struct RangeSieve {
+  vector<uint64_t> bits;
+  uint64_t base = 0;
+  uint64_t size = 0;
+  bool complete = false;   // all factors below sqrt(range end) were sieved
+
+  // if the inputs at or above sieve_limit fall in a narrow enough range,
+  // sieve that whole range with the small primes, so that most of them are
+  // decided by a single lookup
+  void build(const vector<int64_t> & numbers, int n_threads) {
+    int64_t lo = INT64_MAX, hi = 0, count = 0;
+    for (int64_t n : numbers) {
+      if (n < sieve_limit) continue;
+      lo = std::min(lo, n);
+      hi = std::max(hi, n);
+      count++;
+    }
+    if (count == 0) return;
+    uint64_t range = (hi - (lo | 1)) / 2 + 1;
+    if (int64_t(range) > range_max_bits || int64_t(range) > range_cost * count) return;
+
+    base = lo | 1;
+    size = range;
+    complete = uint64_t(hi) < uint64_t(sieve_limit) * uint64_t(sieve_limit);
+    bits.assign((size + 63) / 64, 0);
+    mark_composites_parallel(bits, base, size, sievePrimes, n_threads);
+  }
+
+  // looks n >= sieve_limit up in the range sieve
+  // returns 0 if n is composite, 1 if n is prime and -1 if it is still unknown
+  int lookup(int64_t n) const {
+    if (n % 2 == 0) return 0;
+    uint64_t k = (uint64_t(n) - base) / 2;
+    if (uint64_t(n) < base || k >= size) return -1;
+    if (bits[k >> 6] >> (k & 63) & 1) return 0;
+    return complete ? 1 : -1;
+  }
+};
+
+// bounded LRU cache of primality results for large numbers, shared by all
+// calls; a capacity of 0 disables it
+class PrimeCache{
+  private:
+    size_t capacity = 1 << 16;
+    list<pair<int64_t, bool>> entries;   // most recently used first
+    unordered_map<int64_t, list<pair<int64_t, bool>>::iterator> index;
+    mutex cacheMutex;
+
+    void trim() {
+      while (entries.size() > capacity) {
+        index.erase(entries.back().first);
+        entries.pop_back();
+      }
+    }
+
+  public:
+    void set_capacity(size_t c) {
+      unique_lock<mutex> lock(cacheMutex);
+      capacity = c;
+      trim();
+    }
+
+    // looks up all values[i] for which flags[i] < 0 and fills in the cached
+    // results - one lock for the whole batch
+    void lookup(const vector<int64_t> & values, vector<int8_t> & flags) {
+      unique_lock<mutex> lock(cacheMutex);
+      if (capacity == 0) return;
+      for (size_t i = 0; i < values.size(); i++) {
+        if (flags[i] >= 0) continue;
+        auto f = index.find(values[i]);
+        if (f == index.end()) continue;
+        entries.splice(entries.begin(), entries, f->second);
+        flags[i] = f->second->second;
+      }
+    }
+
+    // remembers the results for values[i] where computed[i] is set
+    void insert(const vector<int64_t> & values, const vector<int8_t> & flags,
+                const vector<char> & computed) {
+      unique_lock<mutex> lock(cacheMutex);
+      if (capacity == 0) return;
+      for (size_t i = 0; i < values.size(); i++) {
+        if (!computed[i] || index.count(values[i])) continue;
+        entries.emplace_front(values[i], flags[i]);
+        index[values[i]] = entries.begin();
+      }
+      trim();
+    }
+};
+
+PrimeCache primeCache;
+
+void set_prime_cache_capacity(size_t capacity) {
+  primeCache.set_capacity(capacity);
+}
+
+// returns true if the large candidate n is prime, otherwise returns false
+// - n has already survived trial division by the small primes
+// - each of the n_threads threads only does its share of the work for n, as
+//   given by its id, and n is prime only if all threads return true
+static bool is_prime(int64_t n, int id, int n_threads, SharedWork & work) {
+  // thread should be cancelled, just return false
+  if (work.cancel->load(memory_order_relaxed)) return false;
+  bool prime = miller_rabin(n, id, n_threads, &work);
+  if (prime) work.finish();
+  return prime;
+}
+
+// holds all the state of one detect_primes() call; every call gets its own
+// engine, so concurrent calls only share the read-only small sieve and the
+// result cache
+//
+// inputs below sieve_limit are answered straight from the sieve, larger ones
+// are deduplicated first so that every distinct value is tested only once
+class PrimeEngine{
+  private:
+    const vector<int64_t> & numbers;  // the caller's input, not copied
+    int numOfThreads;
+
+    vector<int64_t> uniques;          // distinct inputs >= sieve_limit
+    vector<uint32_t> slot;            // numbers[i] == uniques[slot[i]]
+    vector<int8_t> primeFlags;        // primeFlags[u] = 1 if uniques[u] is prime
+                                      // and -1 while it is unknown
+    vector<size_t> pending;           // indices of uniques not in the cache
+    atomic<size_t> nextIndex;         // next pending number to hand out
+    vector<size_t> candidates;        // indices of large prime candidates
+    mutex candidatesMutex;
+    atomic<bool> stop[2];
+    pthread_barrier_t barrier;
+    RangeSieve range;
+
+    // per-thread statistics, each on its own cache line
+    struct alignas(64) PaddedStats{
+        PrimeThreadStats s;
+    };
+    vector<PaddedStats> threadStats;
+
+    struct Task{
+        PrimeEngine * engine;
+        int id;
+    };
+
+    // first pass: threads grab batches of numbers from nextIndex and decide
+    // every number that is small or has a small factor on their own; the
+    // remaining large prime candidates are collected for the second pass
+    void test_small(vector<size_t> & my_candidates, PrimeThreadStats & stats) {
+      size_t sizenums = pending.size();
+      while(1){
+        // guided scheduling: large batches while there is plenty of work left,
+        // smaller ones towards the end so that the threads finish together
+        size_t start = nextIndex.load(memory_order_relaxed);
+        if (start >= sizenums) break;
+        size_t batch = (sizenums - start) / (2 * numOfThreads);
+        batch = std::min(std::max(batch, min_batch), max_batch);
+        start = nextIndex.fetch_add(batch, memory_order_relaxed);
+        if (start >= sizenums) break;
+        size_t end = std::min(start + batch, sizenums);
+        stats.numbers += end - start;
+
+        for (size_t j = start; j < end; j++) {
+          size_t i = pending[j];
+          int64_t n = uniques[i];
+          if (range.size) {
+            int r = range.lookup(n);
+            if (r >= 0) {
+              primeFlags[i] = r;
+              continue;
+            }
+          }
+          if (n < large_limit) {
+            primeFlags[i] = forisek::is_prime(n);
+            continue;
+          }
+          int r = trial_division(n);
+          if (r >= 0) primeFlags[i] = r;
+          else my_candidates.push_back(i);
+        }
+      }
+    }
+
+    // pthread_barrier_wait() that adds the time spent waiting to stats
+    int timed_barrier_wait(PrimeThreadStats & stats) {
+      auto start = chrono::steady_clock::now();
+      int flag = pthread_barrier_wait(&barrier);
+      stats.barrier_wait += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+      return flag;
+    }
+
+    void thread_work(int id) {
+      PrimeThreadStats & stats = threadStats[id].s;
+      vector<size_t> my_candidates;
+      test_small(my_candidates, stats);
+      {
+        unique_lock<mutex> lock(candidatesMutex);
+        candidates.insert(candidates.end(), my_candidates.begin(), my_candidates.end());
+      }
+      timed_barrier_wait(stats);
+
+      // second pass: all threads work on one large candidate at a time, each
+      // trying its share of the witnesses - one barrier per candidate
+      //
+      // candidate k uses stop[k % 2], so the serial thread can record the
+      // result of candidate k and reset its flag for candidate k + 2 while
+      // the other threads already work on candidate k + 1
+      SharedWork work;
+      for (size_t k = 0; k < candidates.size(); k++) {
+        size_t i = candidates[k];
+        work.cancel = &stop[k % 2];
+        if (!is_prime(uniques[i], id, numOfThreads, work)) {
+          stop[k % 2].store(true, memory_order_relaxed);
+        }
+        int flag = timed_barrier_wait(stats);
+        if(flag == PTHREAD_BARRIER_SERIAL_THREAD){
+          primeFlags[i] = !stop[k % 2].load(memory_order_relaxed);
+          stop[k % 2].store(false, memory_order_relaxed);
+        }
+      }
+      stats.mulmods = work.mulmods;
+      stats.wasted = work.wasted;
+    }
+
+    static void * thread_task(void * args){
+      struct Task * in = ((struct Task *) args);
+      in->engine->thread_work(in->id);
+      return NULL;
+    }
+
+  public:
+    PrimeEngine(const vector<int64_t> & nums, int n_threads)
+        : numbers(nums), numOfThreads(n_threads), nextIndex(0),
+          threadStats(n_threads) {
+      stop[0] = stop[1] = false;
+      pthread_barrier_init(&barrier, NULL, n_threads);
+    }
+    ~PrimeEngine() { pthread_barrier_destroy(&barrier); }
+    PrimeEngine(const PrimeEngine &) = delete;
+    PrimeEngine & operator=(const PrimeEngine &) = delete;
+
+    vector<int64_t> run(PrimeStats * stats) {
+      // pre-pass: the small sieve decides the small numbers, the rest are
+      // deduplicated and looked up in the cache
+      build_small_sieve(numOfThreads);
+      const uint32_t no_slot = UINT32_MAX;
+      slot.assign(numbers.size(), no_slot);
+      unordered_map<int64_t, uint32_t> uniqueIndex;
+      for (size_t i = 0; i < numbers.size(); i++) {
+        if (numbers[i] < sieve_limit) continue;
+        auto f = uniqueIndex.emplace(numbers[i], uint32_t(uniques.size()));
+        if (f.second) uniques.push_back(numbers[i]);
+        slot[i] = f.first->second;
+      }
+      primeFlags.assign(uniques.size(), -1);
+      primeCache.lookup(uniques, primeFlags);
+      vector<int64_t> pending_values;
+      for (size_t i = 0; i < uniques.size(); i++) {
+        if (primeFlags[i] >= 0) continue;
+        pending.push_back(i);
+        pending_values.push_back(uniques[i]);
+      }
+      // the range sieve decides the pending numbers in a narrow range
+      range.build(pending_values, numOfThreads);
+
+      if (numOfThreads == 1) {
+        // no point starting a thread just to wait for it
+        thread_work(0);
+      }
+      else {
+        vector<pthread_t> thread_pool(numOfThreads);
+        vector<Task> tasks(numOfThreads);   // prepare memory for each thread
+
+        // create threads and call the thread_task function
+        for(int i = 0; i < numOfThreads; i++){
+          tasks[i] = { this, i };
+          pthread_create(&thread_pool[i], NULL, thread_task, (void *) &tasks[i]);
+        }
+        for(int i = 0; i < numOfThreads; i++){
+          pthread_join(thread_pool[i], NULL);
+        }
+      }
+
+      if (stats) {
+        stats->unique = uniques.size();
+        stats->cached = uniques.size() - pending.size();
+        stats->candidates = candidates.size();
+        stats->threads.clear();
+        for (auto & t : threadStats) stats->threads.push_back(t.s);
+      }
+
+      vector<char> computed(uniques.size(), 0);
+      for (size_t i : pending) computed[i] = uniques[i] >= large_limit;
+      primeCache.insert(uniques, primeFlags, computed);
+
+      // collect the primes in input order, with repetitions
+      vector<int64_t> result;
+      for (size_t i = 0; i < numbers.size(); i++) {
+        int64_t n = numbers[i];
+        bool prime = slot[i] == no_slot ? n >= 2 && sieve_is_prime(n) : primeFlags[slot[i]];
+        if (prime) result.push_back(n);
+      }
+      return result;
+    }
+};
+
+// safe to call from several threads at once and any number of times
+vector<int64_t> detect_primes(const vector<int64_t> & nums, int n_threads,
+                              PrimeStats * stats) {
+  PrimeEngine engine(nums, n_threads);
+  return engine.run(stats);
+}
+
+vector<int64_t> detect_primes(const vector<int64_t> & nums, int n_threads) {
+  return detect_primes(nums, n_threads, nullptr);
+}
+
+// pipeline behind detect_primes_stream(): a parser thread cuts the input into
+// numbered batches, worker threads test the batches with detect_primes(), and
+// the calling thread emits the results of each batch in input order
+class StreamPipeline{
+  private:
+    // the parser waits once this many batches are parsed but not yet emitted,
+    // which bounds the memory no matter how large the input is
+    const size_t max_in_flight;
+    static const size_t batch_size = 4096;
+
+    int fd;
+    int numOfThreads;
+
+    mutex m;
+    condition_variable cv;
+    deque<pair<size_t, vector<int64_t>>> parsed;   // batches waiting for a worker
+    map<size_t, vector<int64_t>> tested;           // primes of finished batches
+    size_t inFlight = 0;      // batches parsed but not emitted yet
+    size_t nParsed = 0;       // total number of batches parsed so far
+    bool parserDone = false;
+
+    struct Task{
+        StreamPipeline * pipeline;
+    };
+
+    void push_batch(vector<int64_t> & batch) {
+      unique_lock<mutex> lock(m);
+      cv.wait(lock, [this] { return inFlight < max_in_flight; });
+      parsed.emplace_back(nParsed++, std::move(batch));
+      inFlight++;
+      cv.notify_all();
+      batch.clear();
+    }
+
+    // reads whitespace separated numbers until EOF or the first token that
+    // is not a number or does not fit in an int64_t, like std::cin >> would
+    // stop; a partial batch is handed out whenever the input has
+    // no more data ready, so a slow feed still gets its results early
+    void parse() {
+      vector<char> buff(1 << 16);
+      vector<int64_t> batch;
+      // the digits so far, without the sign; -2^63 fits, 2^63 does not
+      uint64_t num = 0;
+      bool in_num = false, negative = false, bad = false;
+      while (!bad) {
+        ssize_t len = read(fd, buff.data(), buff.size());
+        if (len <= 0) break;
+        for (ssize_t i = 0; i < len; i++) {
+          char c = buff[i];
+          if (c >= '0' && c <= '9') {
+            uint64_t limit = negative ? uint64_t(INT64_MAX) + 1 : INT64_MAX;
+            if (num > (limit - (c - '0')) / 10) {
+              bad = true;
+              break;
+            }
+            num = num * 10 + (c - '0');
+            in_num = true;
+          }
+          else if (c == '-' && !in_num && !negative) {
+            negative = true;
+          }
+          else if (isspace((unsigned char) c) && !(negative && !in_num)) {
+            if (in_num) {
+              batch.push_back(negative ? int64_t(0 - num) : int64_t(num));
+              if (batch.size() == batch_size) push_batch(batch);
+            }
+            num = 0;
+            in_num = negative = false;
+          }
+          else {
+            bad = true;
+            break;
+          }
+        }
+        if (!batch.empty() && size_t(len) < buff.size()) push_batch(batch);
+      }
+      if (in_num && !bad) batch.push_back(negative ? int64_t(0 - num) : int64_t(num));
+      if (!batch.empty()) push_batch(batch);
+
+      unique_lock<mutex> lock(m);
+      parserDone = true;
+      cv.notify_all();
+    }
+
+    void work() {
+      while (1) {
+        pair<size_t, vector<int64_t>> job;
+        {
+          unique_lock<mutex> lock(m);
+          cv.wait(lock, [this] { return !parsed.empty() || parserDone; });
+          if (parsed.empty()) return;
+          job = std::move(parsed.front());
+          parsed.pop_front();
+        }
+        vector<int64_t> primes = detect_primes(job.second, 1);
+        unique_lock<mutex> lock(m);
+        tested.emplace(job.first, std::move(primes));
+        cv.notify_all();
+      }
+    }
+
+    static void * parser_task(void * args){
+      ((struct Task *) args)->pipeline->parse();
+      return NULL;
+    }
+    static void * worker_task(void * args){
+      ((struct Task *) args)->pipeline->work();
+      return NULL;
+    }
+
+  public:
+    StreamPipeline(int fd, int n_threads)
+        : max_in_flight(4 * n_threads), fd(fd), numOfThreads(n_threads) {}
+
+    int64_t run(const function<void(const vector<int64_t> &)> & emit) {
+      Task task = { this };
+      pthread_t parser;
+      vector<pthread_t> workers(numOfThreads);
+      pthread_create(&parser, NULL, parser_task, (void *) &task);
+      for (auto & w : workers) pthread_create(&w, NULL, worker_task, (void *) &task);
+
+      // ordered writer: emit batch k as soon as batches 0 .. k are tested
+      int64_t count = 0;
+      for (size_t next = 0;; next++) {
+        vector<int64_t> primes;
+        {
+          unique_lock<mutex> lock(m);
+          cv.wait(lock, [&] { return tested.count(next) || (parserDone && next == nParsed); });
+          if (!tested.count(next)) break;
+          primes = std::move(tested[next]);
+          tested.erase(next);
+          inFlight--;
+          cv.notify_all();
+        }
+        count += primes.size();
+        if (!primes.empty()) emit(primes);
+      }
+
+      pthread_join(parser, NULL);
+      for (auto & w : workers) pthread_join(w, NULL);
+      return count;
+    }
+};
+
+int64_t detect_primes_stream(int fd, int n_threads,
+                             const function<void(const vector<int64_t> &)> & emit) {
+  StreamPipeline pipeline(fd, n_threads);
+  return pipeline.run(emit);
 }
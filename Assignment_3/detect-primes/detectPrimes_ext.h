@@ -0,0 +1,30 @@
+#pragma once
+#include "detectPrimes_stats.h"
+#include <cinttypes>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+// detect_primes() overloads and options beyond the ones of detectPrimes.h,
+// which is not to be edited; they are defined in detectPrimes.cpp
+
+/// same as detect_primes(), and if stats is not null, also fills it in
+std::vector<int64_t>
+detect_primes(const std::vector<int64_t> & nums, int n_threads, PrimeStats * stats);
+
+/// results for large numbers are kept in an LRU cache shared by all calls
+/// to detect_primes(); this sets the maximum number of cached results
+/// (default 65536), 0 disables the cache
+void set_prime_cache_capacity(size_t capacity);
+
+/// streaming version of detect_primes(): a parser thread reads whitespace
+/// separated numbers from the file descriptor fd with read(), n_threads
+/// worker threads test them in batches, and emit() is called (on the calling
+/// thread) with the primes of each batch in input order, as soon as all
+/// earlier batches are done
+/// - nothing is read through stdio, so a FILE * on fd must not have
+///   buffered any of its input yet
+/// - only a bounded number of batches is ever in memory
+/// - returns the total number of primes found
+int64_t detect_primes_stream(int fd, int n_threads,
+                             const std::function<void(const std::vector<int64_t> &)> & emit);
@@ -0,0 +1,24 @@
+#pragma once
+#include <cinttypes>
+#include <vector>
+
+/// what one thread did during a detect_primes() call
+struct PrimeThreadStats {
+  // numbers this thread tested on its own in the first pass
+  int64_t numbers = 0;
+  // Montgomery multiplications this thread did on the large candidates
+  // shared by all threads (the Miller-Rabin witnesses are split by thread)
+  int64_t mulmods = 0;
+  // how much of that work was done after another thread had already found
+  // the candidate to be composite (counted in whole polling chunks)
+  int64_t wasted = 0;
+  // seconds spent waiting on barriers
+  double barrier_wait = 0;
+};
+
+struct PrimeStats {
+  int64_t unique = 0;      // distinct inputs that needed more than a sieve lookup
+  int64_t cached = 0;      // of those, answered by the result cache
+  int64_t candidates = 0;  // large prime candidates shared by all threads
+  std::vector<PrimeThreadStats> threads;
+};
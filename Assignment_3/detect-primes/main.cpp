@@ -5,9 +5,12 @@
 /// DO NOT EDIT THIS FILE. DO NOT SUBMIT THIS FILE FOR GRADING.
 
 #include "detectPrimes.h"
+#include "detectPrimes_ext.h"
 #include <chrono>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
+#include <unistd.h>
 
 namespace forisek {
 bool is_prime(uint64_t x);
@@ -33,16 +36,75 @@ struct Timer {
   std::chrono::time_point<std::chrono::steady_clock> start;
 };
 
+// prints numbers separated by spaces, wrapped into lines of at most
+// max_line_width characters, each indented by 2 spaces
+struct LinePrinter {
+  static constexpr size_t max_line_width = 77;
+  std::string line;
+
+  void add(int64_t num)
+  {
+    auto numstr = std::to_string(num);
+    if (line.empty()) {
+      line = numstr;
+      return;
+    }
+    std::string line2 = line + " " + numstr;
+    if (line2.size() > max_line_width) {
+      std::cout << "  " << line << "\n";
+      line = numstr;
+    } else {
+      line = line2;
+    }
+  }
+  void flush()
+  {
+    if (line.size()) std::cout << "  " << line << "\n";
+    line.clear();
+  }
+};
+
+// reads, tests and prints the numbers as a pipeline, printing the primes of
+// each batch as soon as the batch and all batches before it are done; the
+// last, partly filled line of a batch is carried over to the next one, so
+// the lines are packed the same as without --stream
+static int run_stream(int nThreads)
+{
+  Timer t;
+  LinePrinter printer;
+  int64_t count = detect_primes_stream(STDIN_FILENO, nThreads,
+      [&](const std::vector<int64_t> & primes) {
+        for (auto num : primes) printer.add(num);
+        std::cout.flush();
+      });
+  printer.flush();
+  double elapsed = t.elapsed();
+  std::cout << "Identified " << count << " primes.\n";
+  std::cout << "\nFinished in " << std::fixed << std::setprecision(4) << elapsed
+            << "s\n";
+  return 0;
+}
+
 int main(int argc, char ** argv)
 {
   /// parse command line arguments
   int nThreads = 1;
-  if (argc != 1 && argc != 2) {
-    std::cout << "Usage: " << argv[0] << " [nThreads]\n"
-              << "    the default for nThreads is 1 thread.\n";
+  bool printStats = false;
+  bool stream = false;
+  std::vector<char *> args;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--stats") == 0) printStats = true;
+    else if (strcmp(argv[i], "--stream") == 0) stream = true;
+    else args.push_back(argv[i]);
+  }
+  if (args.size() > 1 || (stream && printStats)) {
+    std::cout << "Usage: " << argv[0] << " [nThreads] [--stats | --stream]\n"
+              << "    the default for nThreads is 1 thread.\n"
+              << "    --stats prints per-thread work counters.\n"
+              << "    --stream prints primes while the input is still being read.\n";
     exit(-1);
   }
-  if (argc == 2) nThreads = atoi(argv[1]);
+  if (args.size() == 1) nThreads = atoi(args[0]);
 
   /// handle invalid arguments
   if (nThreads < 1 || nThreads > 256) {
@@ -51,6 +113,8 @@ int main(int argc, char ** argv)
   }
   std::cout << "Using " << nThreads << " thread" << (nThreads == 1 ? "" : "s")
             << ".\n";
+  if (stream) return run_stream(nThreads);
+
   std::vector<int64_t> nums;
   while (1) {
     int64_t num;
@@ -59,30 +123,39 @@ int main(int argc, char ** argv)
   }
   /// time detect_primes()
   Timer t;
-  std::vector<int64_t> primes = detect_primes(nums, nThreads);
+  PrimeStats stats;
+  std::vector<int64_t> primes = detect_primes(nums, nThreads, &stats);
   double elapsed = t.elapsed();
 
   /// report results
   std::cout << "Identified " << primes.size() << " primes:\n";
-  constexpr size_t max_line_width = 77;
-  std::string line;
-  for (auto num : primes) {
-    auto numstr = std::to_string(num);
-    if (line.empty()) {
-      line = numstr;
-      continue;
-    }
-    std::string line2 = line + " " + numstr;
-    if (line2.size() > max_line_width) {
-      std::cout << "  " << line << "\n";
-      line = numstr;
-    } else {
-      line = line2;
-    }
-  }
-  if (line.size()) std::cout << "  " << line << "\n";
+  LinePrinter printer;
+  for (auto num : primes) printer.add(num);
+  printer.flush();
 
   std::cout << "\nFinished in " << std::fixed << std::setprecision(4) << elapsed
             << "s\n";
+
+  if (printStats) {
+    std::cout << "\nDistinct large inputs: " << stats.unique << " ("
+              << stats.cached << " cached), shared candidates: "
+              << stats.candidates << "\n"
+              << "thread    numbers     mulmods      wasted  barrier wait\n";
+    PrimeThreadStats total;
+    for (size_t i = 0; i < stats.threads.size(); i++) {
+      const auto & ts = stats.threads[i];
+      std::cout << std::setw(6) << i << std::setw(11) << ts.numbers
+                << std::setw(12) << ts.mulmods
+                << std::setw(12) << ts.wasted << std::setw(13) << ts.barrier_wait
+                << "s\n";
+      total.numbers += ts.numbers;
+      total.mulmods += ts.mulmods;
+      total.wasted += ts.wasted;
+      total.barrier_wait += ts.barrier_wait;
+    }
+    std::cout << " total" << std::setw(11) << total.numbers << std::setw(12)
+              << total.mulmods << std::setw(12)
+              << total.wasted << std::setw(13) << total.barrier_wait << "s\n";
+  }
   return 0;
 }
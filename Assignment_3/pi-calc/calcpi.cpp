@@ -16,16 +16,24 @@
 // the computation.
 
 #include "calcpi.h"
+#include <chrono>
 #include <iostream>
+#include <vector>
 #include <pthread.h>  
 
 using namespace std;
 
-struct Task{
+// each thread writes partial_count into its own Task, so every Task gets its
+// own cache line - otherwise neighbouring threads keep invalidating each
+// other's line (false sharing)
+constexpr size_t CACHE_LINE = 64;
+
+struct alignas(CACHE_LINE) Task{
     int r;
     double start_x;
     double end_x;
     uint64_t partial_count;
+    double seconds;   // how long this thread spent counting
 };
 
 // each thread will run this method and find where they will start_x given the 
@@ -33,6 +41,7 @@ struct Task{
 // - https://github.com/colinauyeung/CPSC457-F22-Notes/blob/master/Week6/threads/workdivison.cpp
 void * thread_task(void * args){
   struct Task * in = ((struct Task *) args);
+  auto t_start = chrono::steady_clock::now();
   
   int r = in -> r;
   double rsq = double(r) * r;
@@ -50,16 +59,19 @@ void * thread_task(void * args){
   }
   // keep the partial_count for the particular thread in the struct
   in->partial_count = partial_count;
+  in->seconds = chrono::duration<double>(chrono::steady_clock::now() - t_start).count();
 
   pthread_exit(NULL);
 }
 
 // contents of this function were based on code from lines 330-360:
 // - https://github.com/colinauyeung/CPSC457-F22-Notes/blob/master/Week6/threads/workdivison.cpp
-uint64_t count_pixels(int r, int n_threads) {
+// declared in calcpi_timed.h, for the bench mode of main.cpp
+uint64_t count_pixels_timed(int r, int n_threads, vector<double> & thread_seconds) {
   // ============== setting up thread ============== //
-  pthread_t thread_pool[n_threads];
-  Task tasks[n_threads];
+  // heap allocated: up to 256 cache-line sized tasks do not belong on the stack
+  vector<pthread_t> thread_pool(n_threads);
+  vector<Task> tasks(n_threads);
 
   int div = r / n_threads;
   int mod = r % n_threads;
@@ -94,10 +106,17 @@ uint64_t count_pixels(int r, int n_threads) {
 
   // add up all partial_counts to get final result
   uint64_t count = 0;
+  thread_seconds.resize(n_threads);
   for(int i = 0; i< n_threads; i++){
       count = count + tasks[i].partial_count;
+      thread_seconds[i] = tasks[i].seconds;
   }
   // ================================================ //
 
   return count * 4 + 1;
 }
+
+uint64_t count_pixels(int r, int n_threads) {
+  vector<double> thread_seconds;
+  return count_pixels_timed(r, n_threads, thread_seconds);
+}
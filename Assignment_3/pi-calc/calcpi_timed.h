@@ -0,0 +1,8 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// same as count_pixels(), but also reports how many seconds each thread
+// spent counting in thread_seconds[] (one entry per thread); defined in
+// calcpi.cpp, for the bench mode of main.cpp only
+uint64_t count_pixels_timed(int r, int n_threads, std::vector<double> & thread_seconds);
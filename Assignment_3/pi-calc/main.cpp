@@ -5,21 +5,74 @@
 /// DO NOT EDIT THIS FILE. DO NOT SUBMIT THIS FILE FOR GRADING.
 
 #include "calcpi.h"
+#include "calcpi_timed.h"
 #include <iostream>
 #include <iomanip>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <vector>
 
 void usage()
 {
   std::cout << "Usage: ./calcpi radius n_threads\n"
             << "   where 0 <= radius <= 100000\n"
-            << "     and 1 <= n_threads <= 256\n";
+            << "     and 1 <= n_threads <= 256\n"
+            << "   or:   ./calcpi bench [radius ...]\n"
+            << "   to sweep n_threads = 1,2,4,...,256 for each radius\n"
+            << "   (default radii: 1000 10000 50000) and print CSV\n";
   exit(-1);
 }
 
+// runs count_pixels() for every combination of radius and n_threads and
+// prints one CSV row per run; speedup and efficiency are relative to the
+// single-threaded run for the same radius
+int bench(const std::vector<int> & radii)
+{
+  std::cout << "radius,n_threads,count,seconds,speedup,efficiency,"
+               "thread_seconds_avg,thread_seconds_max\n";
+  for (int r : radii) {
+    double t1 = 0;
+    for (int n_threads = 1; n_threads <= 256; n_threads *= 2) {
+      std::vector<double> thread_seconds;
+      auto start = std::chrono::steady_clock::now();
+      uint64_t count = count_pixels_timed(r, n_threads, thread_seconds);
+      double elapsed = std::chrono::duration<double>(
+          std::chrono::steady_clock::now() - start).count();
+      if (n_threads == 1) t1 = elapsed;
+
+      double sum = 0, max = 0;
+      for (double s : thread_seconds) {
+        sum += s;
+        if (s > max) max = s;
+      }
+      double speedup = elapsed > 0 ? t1 / elapsed : 0;
+      std::cout << r << "," << n_threads << "," << count << ","
+                << std::fixed << std::setprecision(6) << elapsed << ","
+                << std::setprecision(3) << speedup << ","
+                << speedup / n_threads << ","
+                << std::setprecision(6) << sum / n_threads << "," << max
+                << "\n";
+      std::cout.unsetf(std::ios_base::floatfield);
+    }
+  }
+  return 0;
+}
+
 int main(int argc, char ** argv)
 {
+  if( argc >= 2 && strcmp(argv[1], "bench") == 0) {
+    std::vector<int> radii;
+    for (int i = 2; i < argc; i++) {
+      int r;
+      if( 1 != sscanf( argv[i], "%d", & r) || r < 0 || r > 100000) usage();
+      radii.push_back(r);
+    }
+    if (radii.empty()) radii = { 1000, 10000, 50000 };
+    return bench(radii);
+  }
+
   int r, n_threads;
   if( argc != 3) usage();
   if( 1 != sscanf( argv[1], "%d", & r)) usage();
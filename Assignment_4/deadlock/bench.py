@@ -0,0 +1,83 @@
+#!/bin/env python3
+
+# Benchmark for find_deadlock
+#
+# Generates traces with gen.py into bench/ (once) and then runs the deadlock
+# binary on each of them in every mode. It records the find_deadlock() time
+# reported by the binary, the wall time and the peak resident memory of the
+# whole run. The results are printed, and written to bench/results.csv. A run
+# is killed after TIMEOUT seconds and reported as a timeout.
+import os, subprocess, sys, threading, time
+import gen
+
+BENCH_DIR = "bench"
+TIMEOUT = 120
+
+# name: (processes, resources, edges, cycle depth, deadlock position)
+WORKLOADS = {
+    "small":       (1000, 1000, 10000, 2, 9999),
+    "medium":      (20000, 20000, 200000, 8, 150000),
+    "large":       (200000, 200000, 1000000, 32, 999999),
+    "large-early": (200000, 200000, 1000000, 4, 1000),
+    "large-none":  (200000, 200000, 1000000, 1, -1),
+    "deep":        (20000, 20000, 200000, 5000, 199999),
+    "deep-large":  (200000, 200000, 1000000, 20000, 999999),
+    "deepest":     (200000, 200000, 1000000, 50000, 999999),
+}
+
+MODES = {
+    "online": [],
+    "batch": ["--batch"],
+    "online-1t": ["--threads", "1"],
+}
+
+
+def run(binary, extra, path):
+    """returns (index, find_deadlock seconds, wall seconds, peak KiB), or
+    None if the run took longer than TIMEOUT"""
+    with open(path) as f:
+        start = time.perf_counter()
+        proc = subprocess.Popen([binary] + extra, stdin=f, stdout=subprocess.PIPE, text=True)
+        timer = threading.Timer(TIMEOUT, proc.kill)
+        timer.start()
+        out = proc.stdout.read()
+        _, status, usage = os.wait4(proc.pid, 0)
+        wall = time.perf_counter() - start
+        timer.cancel()
+    if wall >= TIMEOUT:
+        return None
+    assert os.waitstatus_to_exitcode(status) == 0, f"{binary} failed on {path}"
+    fields = {}
+    for line in out.splitlines():
+        if ":" in line:
+            k, v = line.split(":", 1)
+            fields[k.strip()] = v.strip()
+    return int(fields["index"]), float(fields["real time"].rstrip("s")), wall, usage.ru_maxrss
+
+
+def main(argv):
+    binary = argv[1] if len(argv) > 1 else "./deadlock"
+    os.makedirs(BENCH_DIR, exist_ok=True)
+    rows = ["workload,mode,edges,index,find_deadlock_s,wall_s,peak_kib"]
+    print(f"{'workload':<12} {'mode':<10} {'index':>8} {'find_s':>8} {'wall_s':>8} {'peak_MiB':>9}")
+    for name, (n_procs, n_res, n_edges, depth, at) in WORKLOADS.items():
+        path = os.path.join(BENCH_DIR, f"{name}.txt")
+        if not os.path.exists(path):
+            with open(path, "w") as f:
+                f.write("\n".join(gen.generate(n_procs, n_res, n_edges, depth, at, name)) + "\n")
+        for mode, extra in MODES.items():
+            res = run(binary, extra, path)
+            if res is None:
+                rows.append(f"{name},{mode},{n_edges},,timeout,,")
+                print(f"{name:<12} {mode:<10} {'':>8} {'timeout':>8}")
+                continue
+            index, find_s, wall_s, peak = res
+            assert index == at, f"{name}/{mode}: expected index {at}, got {index}"
+            rows.append(f"{name},{mode},{n_edges},{index},{find_s:.4f},{wall_s:.4f},{peak}")
+            print(f"{name:<12} {mode:<10} {index:>8} {find_s:>8.4f} {wall_s:>8.4f} {peak / 1024:>9.1f}")
+    with open(os.path.join(BENCH_DIR, "results.csv"), "w") as f:
+        f.write("\n".join(rows) + "\n")
+
+
+if __name__ == "__main__":
+    main(sys.argv)
@@ -0,0 +1,144 @@
+#include "edge_parser.h"
+#include <cctype>
+#include <unistd.h>
+
+namespace {
+
+bool is_space(char c) { return isspace((unsigned char) c); }
+
+// returns the next token of line starting at pos, and moves pos past it
+std::string_view next_token(std::string_view line, size_t & pos)
+{
+    while (pos < line.size() && is_space(line[pos]))
+        pos++;
+    size_t start = pos;
+    while (pos < line.size() && !is_space(line[pos]))
+        pos++;
+    return line.substr(start, pos - start);
+}
+
+bool is_alnum(std::string_view str)
+{
+    for (char c : str)
+        if (!isalnum((unsigned char) c))
+            return false;
+    return true;
+}
+
+// parses str as a whole decimal integer, with an optional minus sign
+bool parse_int(std::string_view str, int & value)
+{
+    size_t i = !str.empty() && str[0] == '-';
+    if (i == str.size() || str.size() - i > 9)
+        return false;
+    value = 0;
+    for (; i < str.size(); i++) {
+        if (!isdigit((unsigned char) str[i]))
+            return false;
+        value = 10 * value + (str[i] - '0');
+    }
+    if (str[0] == '-')
+        value = -value;
+    return true;
+}
+
+} // anonymous namespace
+
+int parse_edge_line(std::string_view line, EdgeRecord & rec)
+{
+    size_t pos = 0;
+    auto proc = next_token(line, pos);
+    if (proc.empty())
+        return 0;
+    auto dir = next_token(line, pos);
+    auto res = next_token(line, pos);
+    auto extra = next_token(line, pos);
+    if ((dir != "->" && dir != "<-") || res.empty() || !extra.empty()
+        || !is_alnum(proc) || !is_alnum(res))
+        return -1;
+    rec.proc = proc;
+    rec.request = dir == "->";
+    rec.res = res;
+    return 1;
+}
+
+int parse_event_line(std::string_view line, ResourceEvent & ev)
+{
+    size_t pos = 0;
+    auto first = next_token(line, pos);
+    if (first.empty())
+        return 0;
+    auto op = next_token(line, pos);
+    auto second = next_token(line, pos);
+    auto count = next_token(line, pos);
+    auto extra = next_token(line, pos);
+    if (!extra.empty() || !is_alnum(first) || !is_alnum(second) || second.empty())
+        return -1;
+    ev.count = 1;
+    if (!count.empty() && !parse_int(count, ev.count))
+        return -1;
+    if (op == "=") {
+        // "res = n": the count is the second token
+        if (!count.empty() || !parse_int(second, ev.count) || ev.count < 0)
+            return -1;
+        ev.kind = ResourceEvent::Declare;
+        ev.proc = std::string_view();
+        ev.res = first;
+        return 1;
+    }
+    if (op == "=>" && !count.empty() && ev.count >= 0)
+        ev.kind = ResourceEvent::Claim;
+    else if (op == "->" && ev.count > 0)
+        ev.kind = ResourceEvent::Request;
+    else if (op == "<-" && ev.count != 0)
+        ev.kind = ResourceEvent::Allocate;
+    else
+        return -1;
+    ev.proc = first;
+    ev.res = second;
+    return 1;
+}
+
+EdgeReader::EdgeReader(int fd)
+{
+    // read in blocks straight into the buffer, doubling it as needed
+    size_t len = 0;
+    buffer.resize(1 << 20);
+    while (1) {
+        if (len == buffer.size())
+            buffer.resize(2 * buffer.size());
+        ssize_t n = read(fd, &buffer[len], buffer.size() - len);
+        if (n <= 0)
+            break;
+        len += n;
+    }
+    buffer.resize(len);
+}
+
+template <typename Record, typename Parse>
+int EdgeReader::next_record(Record & rec, Parse parse)
+{
+    std::string_view all(buffer);
+    while (pos < all.size()) {
+        size_t end = all.find('\n', pos);
+        if (end == std::string_view::npos)
+            end = all.size();
+        last_line = all.substr(pos, end - pos);
+        pos = end + 1;
+        line_no++;
+        int r = parse(last_line, rec);
+        if (r != 0)
+            return r;
+    }
+    return 0;
+}
+
+int EdgeReader::next(EdgeRecord & rec)
+{
+    return next_record(rec, parse_edge_line);
+}
+
+int EdgeReader::next(ResourceEvent & ev)
+{
+    return next_record(ev, parse_event_line);
+}
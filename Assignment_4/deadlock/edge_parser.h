@@ -0,0 +1,59 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+/// one parsed input line, "proc -> res" (request) or "proc <- res"
+/// (assignment); the names are views into the parser's buffer
+struct EdgeRecord {
+    std::string_view proc;
+    bool request;
+    std::string_view res;
+};
+
+/// parses a single line into rec
+/// returns 1 on success, 0 if the line is blank and -1 on a syntax error
+int parse_edge_line(std::string_view line, EdgeRecord & rec);
+
+/// one parsed line of a trace with multi-instance resources:
+///   "res = n"          resource res has n instances (1 if never declared)
+///   "proc => res n"    proc may claim at most n instances of res (Banker's)
+///   "proc -> res [n]"  proc requests n more instances of res (default 1)
+///   "proc <- res [n]"  n instances of res are allocated to proc, or
+///                      released by it if n is negative
+/// the names are views into the parser's buffer
+struct ResourceEvent {
+    enum Kind { Declare, Claim, Request, Allocate };
+    Kind kind;
+    std::string_view proc;    // empty for Declare
+    std::string_view res;
+    int count;
+};
+
+/// parses a single line into ev
+/// returns 1 on success, 0 if the line is blank and -1 on a syntax error
+int parse_event_line(std::string_view line, ResourceEvent & ev);
+
+/// reads a whole file descriptor in large blocks into one buffer, and then
+/// hands out its lines as EdgeRecords without any further allocation
+///
+/// the records stay valid for as long as the EdgeReader lives
+class EdgeReader {
+    std::string buffer;
+    size_t pos = 0;
+    int line_no = 0;
+    std::string_view last_line;
+
+    template <typename Record, typename Parse>
+    int next_record(Record & rec, Parse parse);
+
+public:
+    explicit EdgeReader(int fd);
+    /// parses the next non-blank line into rec
+    /// returns 1 on success, 0 at the end of input and -1 on a syntax error
+    int next(EdgeRecord & rec);
+    /// same, for traces of ResourceEvents
+    int next(ResourceEvent & ev);
+    /// the line number and text of the line last looked at by next()
+    int line_number() const { return line_no; }
+    std::string_view line() const { return last_line; }
+};
@@ -2,29 +2,261 @@
 
 #include "find_deadlock.h"
 #include "common.h"
+#include "edge_parser.h"
+#include "graph.h"
+#include "parallel_trim.h"
+#include <algorithm>
 
-/// this is the function you need to (re)implement
+namespace {
+
+/// graphs with fewer edges than this are not worth starting threads for
+constexpr size_t parallel_min_edges = 1 << 16;
+
+/// find_deadlock() gives up on the incremental detector once it has visited
+/// this many nodes and edges per edge added so far, plus min_work; random
+/// graphs take about 2
+constexpr size_t work_per_edge = 16;
+constexpr size_t min_work = 1 << 20;
+
+/// returns the nodes of the deadlocked processes in the first n_edges edges
+std::vector<int> collect_deadlocked(const WaitForGraph & graph, size_t n_edges)
+{
+    int n_threads = deadlock_threads();
+    if (n_threads > 1 && n_edges >= parallel_min_edges)
+        return deadlocked_procs_parallel(graph, n_edges, n_threads);
+    return deadlocked_procs(graph, n_edges);
+}
+
+/// incremental cycle detection for a directed graph that only ever grows
+///
+/// maintains a topological order of all nodes (Pearce & Kelly, "A dynamic
+/// topological sort algorithm for directed acyclic graphs", 2006): adding
+/// an edge x->y that agrees with the order costs O(1), otherwise only the
+/// nodes whose order lies between y and x are searched and reordered; the
+/// edge closes a cycle exactly when y can already reach x
+///
+/// adjacency is kept as linked lists threaded through flat arrays: the
+/// edges leaving node n are first_out[n], next_out[first_out[n]], ... and
+/// likewise for the edges entering n
 ///
+/// the searches are not bounded by anything but the graph, so a long chain
+/// added against the order costs quadratic time; work() counts the nodes and
+/// edges visited so far, so that callers can give up on it
+class IncrementalCycleDetector {
+    std::vector<int> first_out, first_in;   // per node, -1 = no edge
+    std::vector<int> next_out, next_in;     // per edge, -1 = last edge
+    std::vector<Edge> edges;
+    std::vector<int> ord;        // ord[node] = position in the topological order
+    std::vector<int> visited;    // visited[node] == stamp if seen in this search
+    int stamp = 0;
+    size_t n_visited = 0;
+    std::vector<int> delta_f, delta_b, stack, positions;
+
+    // collects into delta_f the nodes reachable from y with order < ub;
+    // returns false if x is among them (so x->y would close a cycle)
+    bool forward(int y, int x, int ub)
+    {
+        delta_f.clear();
+        stack.assign(1, y);
+        visited[y] = stamp;
+        while (!stack.empty()) {
+            int n = stack.back();
+            stack.pop_back();
+            delta_f.push_back(n);
+            for (int e = first_out[n]; e >= 0; e = next_out[e]) {
+                n_visited++;
+                int w = edges[e].to;
+                if (w == x)
+                    return false;
+                if (visited[w] != stamp && ord[w] < ub) {
+                    visited[w] = stamp;
+                    stack.push_back(w);
+                }
+            }
+        }
+        return true;
+    }
+    // collects into delta_b the nodes that reach x with order > lb
+    void backward(int x, int lb)
+    {
+        delta_b.clear();
+        stack.assign(1, x);
+        visited[x] = stamp;
+        while (!stack.empty()) {
+            int n = stack.back();
+            stack.pop_back();
+            delta_b.push_back(n);
+            for (int e = first_in[n]; e >= 0; e = next_in[e]) {
+                n_visited++;
+                int w = edges[e].from;
+                if (visited[w] != stamp && ord[w] > lb) {
+                    visited[w] = stamp;
+                    stack.push_back(w);
+                }
+            }
+        }
+    }
+    // moves all of delta_b in front of all of delta_f, reusing their positions
+    void reorder()
+    {
+        auto by_ord = [this](int a, int b) { return ord[a] < ord[b]; };
+        std::sort(delta_b.begin(), delta_b.end(), by_ord);
+        std::sort(delta_f.begin(), delta_f.end(), by_ord);
+        n_visited += delta_b.size() + delta_f.size();
+        positions.clear();
+        for (int n : delta_b)
+            positions.push_back(ord[n]);
+        for (int n : delta_f)
+            positions.push_back(ord[n]);
+        std::sort(positions.begin(), positions.end());
+        size_t i = 0;
+        for (int n : delta_b)
+            ord[n] = positions[i++];
+        for (int n : delta_f)
+            ord[n] = positions[i++];
+    }
+
+public:
+    void ensure_node(int n)
+    {
+        while (int(ord.size()) <= n) {
+            ord.push_back(ord.size());
+            first_out.push_back(-1);
+            first_in.push_back(-1);
+            visited.push_back(0);
+        }
+    }
+
+    /// adds edge x->y, returns false (without adding it) if it closes a cycle
+    bool add_edge(Edge edge)
+    {
+        int x = edge.from, y = edge.to;
+        ensure_node(std::max(x, y));
+        if (ord[x] > ord[y]) {
+            stamp++;
+            if (!forward(y, x, ord[x]))
+                return false;
+            backward(x, ord[y]);
+            reorder();
+        }
+        int e = edges.size();
+        edges.push_back(edge);
+        next_out.push_back(first_out[x]);
+        first_out[x] = e;
+        next_in.push_back(first_in[y]);
+        first_in[y] = e;
+        return true;
+    }
+
+    /// number of nodes and edges visited by add_edge() so far
+    size_t work() const { return n_visited; }
+};
+
+/// returns the first deadlock of graph, which holds all the edges, knowing
+/// that its first lo edges have no cycle
+///
+/// The graph of a prefix only ever gains edges as the prefix grows, so
+/// "the first n edges contain a cycle" is monotone in n. Galloping over the
+/// prefix lengths lo + 1, lo + 2, lo + 4, ... finds a prefix with a cycle,
+/// and a binary search between it and the last prefix without one then
+/// finds the first deadlocking edge. Every probe is one linear-time check
+/// of a prefix, so the total cost is O((nodes + index) log (index - lo)).
+Result first_deadlock_after(const WaitForGraph & graph, size_t lo)
+{
+    Result result;
+    result.index = -1;
+    size_t n = graph.edges().size();
+    if (lo >= n)
+        return result;
+
+    // invariant: the first lo edges have no cycle, the first hi edges do
+    size_t hi = lo + 1;
+    while (!has_cycle(graph, hi)) {
+        if (hi == n)
+            return result;
+        size_t step = hi - lo;
+        lo = hi;
+        hi = std::min(hi + 2 * step, n);
+    }
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (has_cycle(graph, mid))
+            hi = mid;
+        else
+            lo = mid;
+    }
+    result.index = hi - 1;
+    for (int node : collect_deadlocked(graph, hi))
+        result.procs.emplace_back(graph.proc_name(node));
+    return result;
+}
+
+} // anonymous namespace
+
 /// parameter edges[] contains a list of request- and assignment- edges
 ///   example of a request edge, process "p1" resource "r1"
 ///     "p1 -> r1"
 ///   example of an assignment edge, process "XYz" resource "XYz"
 ///     "XYz <- XYz"
 ///
-/// You need to process edges[] one edge at a time, and run a deadlock
-/// detection after each edge. As soon as you detect a deadlock, your function
-/// needs to stop processing edges and return an instance of Result structure
-/// with 'index' set to the index that caused the deadlock, and 'procs' set
-/// to contain names of processes that are in the deadlock.
+/// Edges are processed one at a time and the graph is checked for a deadlock
+/// after each edge. As soon as a deadlock is detected, the function stops
+/// processing edges and returns an instance of Result structure with 'index'
+/// set to the index that caused the deadlock, and 'procs' set to contain
+/// names of processes that are in the deadlock.
 ///
-/// To indicate no deadlock was detected after processing all edges, you must
-/// return Result with index=-1 and empty procs.
+/// Names are interned into integer ids by WaitForGraph. Rather than
+/// searching the whole graph for a cycle after every edge, the graph is kept
+/// in topological order by IncrementalCycleDetector, so each edge only costs
+/// a search of the part of the order it disagrees with. Should those
+/// searches visit many more nodes than there were edges so far, as on long
+/// chains added against the order, the rest of the input is searched
+/// by prefixes instead, like find_deadlock_batch() does.
 ///
-Result find_deadlock(const std::vector<std::string> & edges)
+/// To indicate no deadlock was detected after processing all edges, returns
+/// Result with index=-1 and empty procs.
+///
+Result find_deadlock(const std::vector<EdgeRecord> & edges)
 {
-    // let's try to guess the results :)
+    WaitForGraph graph;
+    IncrementalCycleDetector detector;
     Result result;
-    result.procs = split("12 7 7");
-    result.index = 6;
+    result.index = -1;
+    for (size_t i = 0; i < edges.size(); i++) {
+        Edge e = graph.add_edge(edges[i].proc, edges[i].request, edges[i].res);
+        if (detector.work() > work_per_edge * i + min_work) {
+            // the first i edges have no cycle
+            for (size_t j = i + 1; j < edges.size(); j++)
+                graph.add_edge(edges[j].proc, edges[j].request, edges[j].res);
+            return first_deadlock_after(graph, i);
+        }
+        if (detector.add_edge(e))
+            continue;
+
+        // the edge closed a cycle, find everything that is stuck
+        result.index = i;
+        for (int n : collect_deadlocked(graph, i + 1))
+            result.procs.emplace_back(graph.proc_name(n));
+        break;
+    }
     return result;
 }
+
+/// Builds the whole graph and searches its prefixes with
+/// first_deadlock_after(), in O((nodes + index) log index).
+Result find_deadlock_batch(const std::vector<EdgeRecord> & edges)
+{
+    WaitForGraph graph;
+    for (auto & e : edges)
+        graph.add_edge(e.proc, e.request, e.res);
+    return first_deadlock_after(graph, 0);
+}
+
+Result find_deadlock(const std::vector<std::string> & edges)
+{
+    // the records are views into edges[], which outlive them
+    std::vector<EdgeRecord> records(edges.size());
+    for (size_t i = 0; i < edges.size(); i++)
+        parse_edge_line(edges[i], records[i]);
+    return find_deadlock(records);
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include "edge_parser.h"
+#include "find_deadlock.h"
+#include <vector>
+
+/// find_deadlock() overloads beyond the one of find_deadlock.h, which is not
+/// to be edited; they are defined in find_deadlock.cpp
+
+/// same as find_deadlock(), for edges that were already parsed (e.g. by
+/// EdgeReader)
+Result find_deadlock(const std::vector<EdgeRecord> & edges);
+
+/// offline version of find_deadlock(), for when only the first deadlocking
+/// index matters: builds the whole graph up front and then searches the
+/// edge prefixes for the shortest one with a cycle; returns the same Result
+Result find_deadlock_batch(const std::vector<EdgeRecord> & edges);
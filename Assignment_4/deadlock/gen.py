@@ -0,0 +1,73 @@
+#!/bin/env python3
+
+# Random wait-for trace generator for find_deadlock
+#
+# Writes edges "p -> r" (p waits for r) and "p <- r" (r is held by p).
+# Every node gets a random rank and every random edge points from the
+# higher rank to the lower one, so random edges alone never form a cycle.
+# The deadlock is a cycle p0 -> r0 -> p1 -> ... -> r{k-1} -> p0 through k
+# processes and k resources whose ranks decrease along the cycle. Its first
+# 2k-1 edges are scattered before the deadlock position, and the edge that
+# closes it is written exactly at that position. So the first deadlocking
+# index is known in advance.
+import argparse, random, sys
+
+
+def generate(n_procs, n_res, n_edges, depth, at, seed=None):
+    """returns a list of edge lines; the first deadlock is at index 'at',
+    or there is none if at < 0"""
+    rng = random.Random(seed)
+    ranks = list(range(n_procs + n_res))
+    rng.shuffle(ranks)
+    proc_rank = ranks[:n_procs]
+    res_rank = ranks[n_procs:]
+
+    def random_edge():
+        p = rng.randrange(n_procs)
+        r = rng.randrange(n_res)
+        if proc_rank[p] > res_rank[r]:
+            return f"p{p} -> r{r}"
+        return f"p{p} <- r{r}"
+
+    edges = [None] * n_edges
+    if at >= 0:
+        assert 1 <= depth <= min(n_procs, n_res), "bad cycle depth"
+        assert 2 * depth - 1 <= at < n_edges, "bad deadlock position"
+        # re-rank the cycle nodes above all others, decreasing along it
+        procs = rng.sample(range(n_procs), depth)
+        res = rng.sample(range(n_res), depth)
+        top = n_procs + n_res + 2 * depth
+        for i in range(depth):
+            proc_rank[procs[i]] = top - 2 * i
+            res_rank[res[i]] = top - 2 * i - 1
+        cycle = []
+        for i in range(depth):
+            cycle.append(f"p{procs[i]} -> r{res[i]}")
+            if i + 1 < depth:
+                cycle.append(f"p{procs[i + 1]} <- r{res[i]}")
+        for pos, e in zip(sorted(rng.sample(range(at), len(cycle))), cycle):
+            edges[pos] = e
+        edges[at] = f"p{procs[0]} <- r{res[depth - 1]}"
+    for i in range(n_edges):
+        if edges[i] is None:
+            edges[i] = random_edge()
+    return edges
+
+
+def main():
+    ap = argparse.ArgumentParser(description="generate a random deadlock trace")
+    ap.add_argument("-p", "--procs", type=int, default=1000, help="number of processes")
+    ap.add_argument("-r", "--resources", type=int, default=1000, help="number of resources")
+    ap.add_argument("-e", "--edges", type=int, default=10000, help="number of edges")
+    ap.add_argument("-d", "--depth", type=int, default=2, help="processes on the deadlock cycle")
+    ap.add_argument("-a", "--at", type=int, default=None,
+                    help="index of the first deadlocking edge, -1 = no deadlock (default: last edge)")
+    ap.add_argument("-s", "--seed", default=None, help="random seed")
+    args = ap.parse_args()
+    at = args.edges - 1 if args.at is None else args.at
+    edges = generate(args.procs, args.resources, args.edges, args.depth, at, args.seed)
+    sys.stdout.write("\n".join(edges) + "\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,126 @@
+#include "graph.h"
+#include <algorithm>
+#include <functional>
+
+NameTable::NameTable()
+    : starts(1, 0)
+    , slots(16, 0)
+    , mask(15)
+{
+}
+
+// doubles the number of slots and re-inserts all ids
+void NameTable::grow()
+{
+    slots.assign(slots.size() * 2, 0);
+    mask = slots.size() - 1;
+    for (size_t id = 0; id < hashes.size(); id++) {
+        uint64_t s = hashes[id] & mask;
+        while (slots[s])
+            s = (s + 1) & mask;
+        slots[s] = id + 1;
+    }
+}
+
+int NameTable::intern(std::string_view name)
+{
+    uint64_t h = std::hash<std::string_view>()(name);
+    uint64_t s = h & mask;
+    // linear probing, comparing the stored hashes before the strings
+    while (slots[s]) {
+        int id = slots[s] - 1;
+        if (hashes[id] == h && this->name(id) == name)
+            return id;
+        s = (s + 1) & mask;
+    }
+    int id = hashes.size();
+    arena.append(name);
+    starts.push_back(arena.size());
+    hashes.push_back(h);
+    slots[s] = id + 1;
+    // keep the table at most half full
+    if (2 * hashes.size() > slots.size())
+        grow();
+    return id;
+}
+
+Csr Csr::build(int n_nodes, const std::vector<Edge> & edges, size_t n_edges, bool reverse)
+{
+    Csr csr;
+    csr.offset.assign(n_nodes + 1, 0);
+    csr.target.resize(n_edges);
+    // counting sort of the edges by source node
+    for (size_t i = 0; i < n_edges; i++)
+        csr.offset[(reverse ? edges[i].to : edges[i].from) + 1]++;
+    for (int n = 0; n < n_nodes; n++)
+        csr.offset[n + 1] += csr.offset[n];
+    std::vector<int> fill(csr.offset.begin(), csr.offset.end() - 1);
+    for (size_t i = 0; i < n_edges; i++) {
+        const Edge & e = edges[i];
+        if (reverse)
+            csr.target[fill[e.to]++] = e.from;
+        else
+            csr.target[fill[e.from]++] = e.to;
+    }
+    return csr;
+}
+
+Edge WaitForGraph::add_edge(std::string_view proc, bool request, std::string_view res)
+{
+    int p = proc_node(procs.intern(proc));
+    int r = res_node(resources.intern(res));
+    // request edge: process waits for resource,
+    // assignment edge: resource is held by process
+    Edge e = request ? Edge { p, r } : Edge { r, p };
+    edge_list.push_back(e);
+    return e;
+}
+
+namespace {
+
+// repeatedly removes nodes without outgoing edges from the graph made of
+// the first n_edges edges; returns the out-degree of every node at the end,
+// which is 0 for removed nodes
+std::vector<int> peel(const WaitForGraph & graph, size_t n_edges)
+{
+    int n_nodes = graph.n_nodes();
+    Csr in = Csr::build(n_nodes, graph.edges(), n_edges, true);
+    std::vector<int> out_degree(n_nodes, 0);
+    for (size_t i = 0; i < n_edges; i++)
+        out_degree[graph.edges()[i].from]++;
+
+    std::vector<int> zeros;
+    for (int n = 0; n < n_nodes; n++)
+        if (out_degree[n] == 0)
+            zeros.push_back(n);
+    while (!zeros.empty()) {
+        int n = zeros.back();
+        zeros.pop_back();
+        for (int i = in.offset[n]; i < in.offset[n + 1]; i++)
+            if (--out_degree[in.target[i]] == 0)
+                zeros.push_back(in.target[i]);
+    }
+    return out_degree;
+}
+
+} // anonymous namespace
+
+std::vector<int> deadlocked_procs(const WaitForGraph & graph, size_t n_edges)
+{
+    std::vector<int> out_degree = peel(graph, n_edges);
+    std::vector<int> procs;
+    for (size_t n = 0; n < out_degree.size(); n += 2)
+        if (out_degree[n] > 0)
+            procs.push_back(n);
+    return procs;
+}
+
+bool has_cycle(const WaitForGraph & graph, size_t n_edges)
+{
+    // every node that cannot be removed is on a cycle or leads to one
+    std::vector<int> out_degree = peel(graph, n_edges);
+    for (int d : out_degree)
+        if (d > 0)
+            return true;
+    return false;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// interns names into dense integer ids 0, 1, 2, ...
+///
+/// like Word2Int, but the names are kept back to back in one string arena
+/// and looked up through an open-addressing hash table of plain integers,
+/// so interning does not allocate a node per name
+class NameTable {
+    std::string arena;               // all names, back to back
+    std::vector<uint32_t> starts;    // name i is arena[starts[i] .. starts[i+1])
+    std::vector<uint64_t> hashes;    // hashes[i] = hash of name i
+    std::vector<uint32_t> slots;     // id + 1 of the name in each slot, 0 = empty
+    uint64_t mask = 0;
+
+    void grow();
+
+public:
+    NameTable();
+    /// returns the id of name, adding it if it is new
+    int intern(std::string_view name);
+    std::string_view name(int id) const
+    {
+        return std::string_view(arena).substr(starts[id], starts[id + 1] - starts[id]);
+    }
+    int size() const { return int(hashes.size()); }
+};
+
+/// a directed edge between two graph nodes
+struct Edge {
+    int from, to;
+};
+
+/// adjacency in compressed sparse row form: the neighbours of node n are
+/// target[offset[n]] .. target[offset[n + 1] - 1]
+struct Csr {
+    std::vector<int> offset, target;
+
+    /// builds the out-adjacency (or the in-adjacency if reverse is set) of
+    /// the first n_edges edges, over n_nodes nodes
+    static Csr build(int n_nodes, const std::vector<Edge> & edges, size_t n_edges, bool reverse);
+    int degree(int n) const { return offset[n + 1] - offset[n]; }
+};
+
+/// wait-for graph of processes and resources
+///
+/// processes and resources are different namespaces, so they are interned
+/// into two separate dense id spaces and then interleaved into graph nodes:
+/// process i is node 2i, resource i is node 2i+1
+class WaitForGraph {
+    NameTable procs, resources;
+    std::vector<Edge> edge_list;
+
+public:
+    static int proc_node(int proc) { return 2 * proc; }
+    static int res_node(int res) { return 2 * res + 1; }
+    static bool is_proc(int node) { return node % 2 == 0; }
+
+    /// appends the request edge "proc -> res" (request = true) or the
+    /// assignment edge "proc <- res" (request = false), returns it
+    Edge add_edge(std::string_view proc, bool request, std::string_view res);
+
+    const std::vector<Edge> & edges() const { return edge_list; }
+    int n_nodes() const { return 2 * std::max(procs.size(), resources.size()); }
+    std::string_view proc_name(int node) const { return procs.name(node / 2); }
+};
+
+/// returns the nodes of processes that are deadlocked in the graph made of
+/// the first n_edges edges: the nodes left after repeatedly removing nodes
+/// without outgoing edges are exactly those on a cycle or waiting for one
+std::vector<int> deadlocked_procs(const WaitForGraph & graph, size_t n_edges);
+
+/// returns true if the graph made of the first n_edges edges has a cycle,
+/// in O(nodes + n_edges)
+bool has_cycle(const WaitForGraph & graph, size_t n_edges);
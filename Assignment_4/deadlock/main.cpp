@@ -6,6 +6,9 @@
 
 #include "common.h"
 #include "find_deadlock.h"
+#include "find_deadlock_ext.h"
+#include "parallel_trim.h"
+#include "resource_pool.h"
 #include <algorithm>
 #include <cassert>
 #include <chrono>
@@ -15,6 +18,7 @@
 #include <memory>
 #include <numeric>
 #include <set>
+#include <unistd.h>
 #include <vector>
 
 namespace {
@@ -53,75 +57,95 @@ std::string join(const VS & toks, const std::string & sep = " ")
     return res;
 }
 
-std::string stdin_readline()
-{
-    std::string result;
-    while (1) {
-        int c = fgetc(stdin);
-        if (c == -1)
-            break;
-        result.push_back(c);
-        if (c == '\n')
-            break;
-    }
-    return result;
-}
-
-// std::string simplify(const std::string& str) { return join(split(str)); }
-
-bool is_alnum(const std::string & str)
-{
-    for (int c : str)
-        if (!isalnum(c))
-            return false;
-    return true;
-}
-
 int usage(const std::string & pname)
 {
     std::cout << "Usage:\n"
-              << "    " << pname << " < input\n"
-              << "        - to process input from stdin\n";
+              << "    " << pname << " [--batch] [--threads n] < input\n"
+              << "        - to process input from stdin\n"
+              << "        - with --batch, only the first deadlock is searched\n"
+              << "          for, over prefixes of the whole input\n"
+              << "        - with --threads, n threads collect the deadlocked\n"
+              << "          processes of large graphs (default: all cores)\n"
+              << "    " << pname << " --multi < input\n"
+              << "        - to detect deadlocks among multi-instance resources\n"
+              << "    " << pname << " --banker < input\n"
+              << "        - to replay multi-instance requests under the\n"
+              << "          Banker's algorithm\n";
     exit(-1);
 }
 
-int cppmain(const VS & args)
+// parses all non-empty lines of stdin into records, quits on syntax errors
+template <typename Record>
+std::vector<Record> read_records(EdgeReader & reader)
 {
-    if (args.size() != 1)
-        usage(args[0]);
-    std::cout << "Reading in lines from stdin...\n";
-    VS all_lines;
-    int line_no = 0;
+    std::vector<Record> records;
+    Record rec;
     while (1) {
-        // read in the next line and quit loop on EOF
-        auto line = stdin_readline();
-        if (line.size() == 0)
+        // parse the next non-empty line and quit loop on EOF
+        int r = reader.next(rec);
+        if (r == 0)
             break;
-        line_no++;
-
-        // get rid of trailing \n
-        if (line.size() && line.back() == '\n')
-            line.pop_back();
-
-        // parse input line, skip empty lines
-        auto toks = split(line);
-        if (toks.size() == 0)
-            continue;
-
-        // validate line
-        if (toks.size() != 3 || (toks[1] != "->" && toks[1] != "<-")
-            || !is_alnum(toks[0]) || !is_alnum(toks[2])) {
-            std::cout << "Syntax error on line " << line_no << ": " << line
-                      << "\n";
+        if (r < 0) {
+            std::cout << "Syntax error on line " << reader.line_number() << ": "
+                      << reader.line() << "\n";
             exit(-1);
         }
+        records.push_back(rec);
+    }
+    return records;
+}
+
+int run_banker_mode(EdgeReader & reader)
+{
+    auto events = read_records<ResourceEvent>(reader);
+    std::cout << "Running run_banker()...\n";
+    Timer timer;
+    BankerResult res = run_banker(events);
+    std::cout << "\n"
+              << "granted    : " << res.granted << "\n"
+              << "deferred   : " << res.deferred << "\n"
+              << "rejected   : " << res.rejected << "\n"
+              << "waiting    : [" << join(res.waiting, ",") << "]\n"
+              << "real time  : " << std::fixed << std::setprecision(4)
+              << timer.elapsed() << "s\n\n";
+    return 0;
+}
 
-        all_lines.push_back(line);
+int cppmain(const VS & args)
+{
+    bool batch = false, multi = false, banker = false;
+    for (size_t i = 1; i < args.size(); i++) {
+        if (args[i] == "--batch")
+            batch = true;
+        else if (args[i] == "--multi")
+            multi = true;
+        else if (args[i] == "--banker")
+            banker = true;
+        else if (args[i] == "--threads" && i + 1 < args.size())
+            set_deadlock_threads(std::atoi(args[++i].c_str()));
+        else
+            usage(args[0]);
     }
+    if (batch + multi + banker > 1)
+        usage(args[0]);
+    std::cout << "Reading in lines from stdin...\n";
+    EdgeReader reader(STDIN_FILENO);
+    if (banker)
+        return run_banker_mode(reader);
 
-    std::cout << "Running find_deadlock()...\n";
+    Result res;
     Timer timer;
-    Result res = find_deadlock(all_lines);
+    if (multi) {
+        auto events = read_records<ResourceEvent>(reader);
+        std::cout << "Running find_deadlock_multi()...\n";
+        timer.reset();
+        res = find_deadlock_multi(events);
+    } else {
+        auto all_edges = read_records<EdgeRecord>(reader);
+        std::cout << "Running find_deadlock" << (batch ? "_batch" : "") << "()...\n";
+        timer.reset();
+        res = batch ? find_deadlock_batch(all_edges) : find_deadlock(all_edges);
+    }
     std::cout << "\n"
               << "index      : " << res.index << "\n"
               << "procs      : [" << join(res.procs, ",") << "]\n"
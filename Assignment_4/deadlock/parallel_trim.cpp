@@ -0,0 +1,125 @@
+#include "parallel_trim.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+
+namespace {
+
+std::atomic<int> n_deadlock_threads { 0 };
+
+/// runs fn(t) for t = 0 .. n_threads-1, each in its own thread, and waits
+/// for all of them; with a single thread fn(0) is called directly
+template <typename Fn>
+void run_threads(int n_threads, Fn fn)
+{
+    if (n_threads == 1) {
+        fn(0);
+        return;
+    }
+    std::vector<std::thread> threads;
+    for (int t = 0; t < n_threads; t++)
+        threads.emplace_back(fn, t);
+    for (auto & th : threads)
+        th.join();
+}
+
+/// the slice [begin, end) of 0 .. n that thread t of n_threads starts from
+void slice(int n, int t, int n_threads, int & begin, int & end)
+{
+    begin = int(int64_t(n) * t / n_threads);
+    end = int(int64_t(n) * (t + 1) / n_threads);
+}
+
+} // anonymous namespace
+
+/// Neither phase needs a barrier: whichever thread claims a node (trims it,
+/// or reaches it) owns it and pushes it on its own stack, and every node is
+/// claimed exactly once through an atomic flag. A thread is done when its
+/// stack runs empty, since any node it did not claim was claimed by another.
+std::vector<int> deadlocked_procs_parallel(const WaitForGraph & graph, size_t n_edges, int n_threads)
+{
+    int n_nodes = graph.n_nodes();
+    n_threads = std::max(1, std::min(n_threads, n_nodes));
+    Csr out = Csr::build(n_nodes, graph.edges(), n_edges, false);
+    Csr in = Csr::build(n_nodes, graph.edges(), n_edges, true);
+
+    std::unique_ptr<std::atomic<int>[]> in_degree(new std::atomic<int>[n_nodes]);
+    std::unique_ptr<std::atomic<int>[]> out_degree(new std::atomic<int>[n_nodes]);
+    // 0 = in the core, 1 = trimmed, 2 = reached from the core
+    std::unique_ptr<std::atomic<char>[]> state(new std::atomic<char>[n_nodes]);
+
+    // trimming: a node is removed once it has no edges left on either side,
+    // which takes away one edge from each of its neighbours
+    run_threads(n_threads, [&](int t) {
+        int begin, end;
+        slice(n_nodes, t, n_threads, begin, end);
+        for (int n = begin; n < end; n++) {
+            in_degree[n].store(in.degree(n), std::memory_order_relaxed);
+            out_degree[n].store(out.degree(n), std::memory_order_relaxed);
+            state[n].store(0, std::memory_order_relaxed);
+        }
+    });
+    run_threads(n_threads, [&](int t) {
+        int begin, end;
+        slice(n_nodes, t, n_threads, begin, end);
+        std::vector<int> stack;
+        auto trim = [&](int n) {
+            if (state[n].exchange(1) == 0)
+                stack.push_back(n);
+        };
+        for (int n = begin; n < end; n++)
+            if (in_degree[n].load() == 0 || out_degree[n].load() == 0)
+                trim(n);
+        while (!stack.empty()) {
+            int n = stack.back();
+            stack.pop_back();
+            for (int i = out.offset[n]; i < out.offset[n + 1]; i++)
+                if (in_degree[out.target[i]].fetch_sub(1) == 1)
+                    trim(out.target[i]);
+            for (int i = in.offset[n]; i < in.offset[n + 1]; i++)
+                if (out_degree[in.target[i]].fetch_sub(1) == 1)
+                    trim(in.target[i]);
+        }
+    });
+
+    // backward reachability: everything left in the core is reached, and so
+    // is every trimmed node with a path into it
+    run_threads(n_threads, [&](int t) {
+        int begin, end;
+        slice(n_nodes, t, n_threads, begin, end);
+        std::vector<int> stack;
+        for (int n = begin; n < end; n++) {
+            char core = 0;
+            if (state[n].compare_exchange_strong(core, 2))
+                stack.push_back(n);
+        }
+        while (!stack.empty()) {
+            int n = stack.back();
+            stack.pop_back();
+            for (int i = in.offset[n]; i < in.offset[n + 1]; i++) {
+                int w = in.target[i];
+                if (state[w].exchange(2) != 2)
+                    stack.push_back(w);
+            }
+        }
+    });
+
+    std::vector<int> procs;
+    for (int n = 0; n < n_nodes; n += 2)
+        if (state[n].load(std::memory_order_relaxed) == 2)
+            procs.push_back(n);
+    return procs;
+}
+
+void set_deadlock_threads(int n_threads)
+{
+    n_deadlock_threads = std::max(0, n_threads);
+}
+
+int deadlock_threads()
+{
+    int n = n_deadlock_threads;
+    if (n == 0)
+        n = std::max(1u, std::thread::hardware_concurrency());
+    return n;
+}
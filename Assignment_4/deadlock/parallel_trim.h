@@ -0,0 +1,19 @@
+#pragma once
+#include "graph.h"
+
+/// multi-threaded version of deadlocked_procs(), for huge wait-for graphs;
+/// returns exactly the same nodes, in the same order
+///
+/// first the graph is trimmed down to its core by repeatedly removing nodes
+/// with no incoming or no outgoing edges. Every node left in the core lies
+/// on a cycle or between cycles. The deadlocked processes are then found by
+/// reachability backwards from the core: every node that can reach the
+/// core waits, directly or not, on a cycle
+std::vector<int> deadlocked_procs_parallel(const WaitForGraph & graph, size_t n_edges, int n_threads);
+
+/// sets the number of threads find_deadlock() uses to collect the deadlocked
+/// processes of large graphs, 0 = one per hardware thread (the default)
+void set_deadlock_threads(int n_threads);
+
+/// returns the number of threads set by set_deadlock_threads(), resolved
+int deadlock_threads();
@@ -0,0 +1,325 @@
+#include "resource_pool.h"
+#include <algorithm>
+#include <numeric>
+
+void DemandIndex::add_type(int n_procs)
+{
+    value.emplace_back(n_procs, 0);
+    order.emplace_back(n_procs);
+    pos.emplace_back(n_procs);
+    std::iota(order.back().begin(), order.back().end(), 0);
+    std::iota(pos.back().begin(), pos.back().end(), 0);
+}
+
+void DemandIndex::add_proc()
+{
+    // the new process demands nothing yet, so it goes in front of the
+    // processes with a positive demand
+    for (size_t r = 0; r < value.size(); r++) {
+        int p = value[r].size();
+        value[r].push_back(0);
+        order[r].push_back(p);
+        pos[r].push_back(p);
+        set(r, p, 0);
+    }
+}
+
+void DemandIndex::set(int r, int p, int v)
+{
+    auto & val = value[r];
+    auto & ord = order[r];
+    auto & ps = pos[r];
+    int old = val[p];
+    val[p] = v;
+    // insertion sort step: shift the neighbours p passes over by one
+    int i = ps[p];
+    if (v > old) {
+        while (i + 1 < int(ord.size()) && val[ord[i + 1]] < v) {
+            ord[i] = ord[i + 1];
+            ps[ord[i]] = i;
+            i++;
+        }
+    } else {
+        while (i > 0 && val[ord[i - 1]] > v) {
+            ord[i] = ord[i - 1];
+            ps[ord[i]] = i;
+            i--;
+        }
+    }
+    ord[i] = p;
+    ps[p] = i;
+}
+
+int ResourcePool::add_type(int n)
+{
+    total.push_back(n);
+    available.push_back(n);
+    alloc.emplace_back(n_procs, 0);
+    claim.emplace_back(n_procs, 0);
+    requests.add_type(n_procs);
+    needs.add_type(n_procs);
+    return n_types++;
+}
+
+bool ResourcePool::set_instances(int r, int n)
+{
+    int allocated = total[r] - available[r];
+    if (n < allocated)
+        return false;
+    total[r] = n;
+    available[r] = n - allocated;
+    return true;
+}
+
+int ResourcePool::add_proc()
+{
+    for (int r = 0; r < n_types; r++) {
+        alloc[r].push_back(0);
+        claim[r].push_back(0);
+    }
+    held.push_back(0);
+    requests.add_proc();
+    needs.add_proc();
+    return n_procs++;
+}
+
+void ResourcePool::set_alloc(int r, int p, int v)
+{
+    held[p] += (v > 0) - (alloc[r][p] > 0);
+    alloc[r][p] = v;
+    needs.set(r, p, claim[r][p] - v);
+}
+
+void ResourcePool::request(int p, int r, int k)
+{
+    requests.set(r, p, requests.get(r, p) + k);
+}
+
+bool ResourcePool::allocate(int p, int r, int k)
+{
+    if (k > available[r] || alloc[r][p] + k < 0)
+        return false;
+    available[r] -= k;
+    set_alloc(r, p, alloc[r][p] + k);
+    if (k > 0)
+        requests.set(r, p, std::max(0, requests.get(r, p) - k));
+    return true;
+}
+
+bool ResourcePool::set_claim(int p, int r, int k)
+{
+    if (k < alloc[r][p])
+        return false;
+    claim[r][p] = k;
+    needs.set(r, p, k - alloc[r][p]);
+    return true;
+}
+
+/// The reduction of the textbook algorithms: with work = Available, keep
+/// finding a process whose demand fits in work, and let it finish and
+/// return its allocation to work. Instead of rescanning all processes for
+/// one that fits, every type r keeps a cursor into its processes sorted by
+/// demand, which only moves forward as work[r] grows; a process can finish
+/// once all m cursors have passed it. So every cursor step and every finish
+/// happens at most once per process and type, O(m n) in total.
+///
+/// returns the number of processes that could not finish (done[p] == 0)
+int ResourcePool::reduce(const DemandIndex & demand, bool skip_idle)
+{
+    work = available;
+    next.assign(n_types, 0);
+    pending.assign(n_procs, n_types);
+    done.assign(n_procs, 0);
+    queue.clear();
+    int left = n_procs;
+    if (n_types == 0) {
+        done.assign(n_procs, 1);
+        return 0;
+    }
+    if (skip_idle) {
+        // processes holding nothing cannot be part of a deadlock
+        for (int p = 0; p < n_procs; p++)
+            if (held[p] == 0) {
+                done[p] = 1;
+                left--;
+            }
+    }
+
+    auto advance = [&](int r) {
+        while (next[r] < n_procs) {
+            int p = demand.at(r, next[r]);
+            if (demand.get(r, p) > work[r])
+                break;
+            next[r]++;
+            if (--pending[p] == 0 && !done[p]) {
+                done[p] = 1;
+                left--;
+                queue.push_back(p);
+            }
+        }
+    };
+    for (int r = 0; r < n_types; r++)
+        advance(r);
+    for (size_t i = 0; i < queue.size(); i++) {
+        int p = queue[i];
+        for (int r = 0; r < n_types; r++)
+            if (alloc[r][p] > 0) {
+                work[r] += alloc[r][p];
+                advance(r);
+            }
+    }
+    return left;
+}
+
+std::vector<int> ResourcePool::detect()
+{
+    std::vector<int> stuck;
+    if (reduce(requests, true) == 0)
+        return stuck;
+    for (int p = 0; p < n_procs; p++)
+        if (!done[p])
+            stuck.push_back(p);
+    return stuck;
+}
+
+bool ResourcePool::is_safe()
+{
+    return reduce(needs, false) == 0;
+}
+
+bool ResourcePool::try_grant(int p, int r, int k)
+{
+    if (k > available[r] || alloc[r][p] + k > claim[r][p])
+        return false;
+    int old_request = requests.get(r, p);
+    allocate(p, r, k);
+    if (is_safe())
+        return true;
+    allocate(p, r, -k);
+    requests.set(r, p, old_request);
+    return false;
+}
+
+namespace {
+
+/// a ResourcePool addressed by the names used in a trace
+struct NamedPool {
+    ResourcePool pool;
+    NameTable procs, resources;
+
+    int proc(std::string_view name)
+    {
+        int p = procs.intern(name);
+        if (p == pool.procs())
+            pool.add_proc();
+        return p;
+    }
+    // resources used before being declared have a single instance
+    int res(std::string_view name)
+    {
+        int r = resources.intern(name);
+        if (r == pool.types())
+            pool.add_type(1);
+        return r;
+    }
+    // returns false if the declaration conflicts with the allocations
+    bool declare(std::string_view name, int instances)
+    {
+        int r = resources.intern(name);
+        if (r == pool.types()) {
+            pool.add_type(instances);
+            return true;
+        }
+        return pool.set_instances(r, instances);
+    }
+};
+
+} // anonymous namespace
+
+/// Replays the events one at a time, and runs the detection reduction
+/// after each one. An allocation of more instances than are available
+/// cannot happen yet, so it is recorded as a request instead; releases of
+/// more than is held, and claims, are ignored.
+Result find_deadlock_multi(const std::vector<ResourceEvent> & events)
+{
+    NamedPool np;
+    Result result;
+    result.index = -1;
+    for (size_t i = 0; i < events.size(); i++) {
+        const ResourceEvent & ev = events[i];
+        if (ev.kind == ResourceEvent::Declare) {
+            np.declare(ev.res, ev.count);
+        } else if (ev.kind == ResourceEvent::Request) {
+            np.pool.request(np.proc(ev.proc), np.res(ev.res), ev.count);
+        } else if (ev.kind == ResourceEvent::Allocate) {
+            int p = np.proc(ev.proc), r = np.res(ev.res);
+            if (!np.pool.allocate(p, r, ev.count) && ev.count > 0)
+                np.pool.request(p, r, ev.count);
+        } else {
+            continue;
+        }
+
+        std::vector<int> stuck = np.pool.detect();
+        if (stuck.empty())
+            continue;
+        result.index = i;
+        for (int p : stuck)
+            result.procs.emplace_back(np.procs.name(p));
+        break;
+    }
+    return result;
+}
+
+BankerResult run_banker(const std::vector<ResourceEvent> & events)
+{
+    struct Waiting {
+        int p, r, k;
+    };
+    NamedPool np;
+    ResourcePool & pool = np.pool;
+    std::vector<Waiting> waiting;
+    BankerResult result;
+    for (auto & ev : events) {
+        if (ev.kind == ResourceEvent::Declare) {
+            if (!np.declare(ev.res, ev.count))
+                result.rejected++;
+            continue;
+        }
+        int p = np.proc(ev.proc), r = np.res(ev.res);
+        if (ev.kind == ResourceEvent::Claim) {
+            if (!pool.set_claim(p, r, ev.count))
+                result.rejected++;
+        } else if (ev.count > 0) {
+            // a request: grant it, or let it wait with the others
+            if (pool.try_grant(p, r, ev.count)) {
+                result.granted++;
+            } else if (!pool.within_claim(p, r, ev.count)) {
+                result.rejected++;
+            } else {
+                result.deferred++;
+                pool.request(p, r, ev.count);
+                waiting.push_back({ p, r, ev.count });
+            }
+        } else if (!pool.allocate(p, r, ev.count)) {
+            result.rejected++;
+        } else {
+            // a release; granting a request never makes another one
+            // grantable, so one pass over the waiting requests is enough
+            size_t kept = 0;
+            for (auto & w : waiting) {
+                if (pool.try_grant(w.p, w.r, w.k))
+                    result.granted++;
+                else
+                    waiting[kept++] = w;
+            }
+            waiting.resize(kept);
+        }
+    }
+    std::vector<char> seen(pool.procs(), 0);
+    for (auto & w : waiting)
+        if (!seen[w.p]) {
+            seen[w.p] = 1;
+            result.waiting.emplace_back(np.procs.name(w.p));
+        }
+    return result;
+}
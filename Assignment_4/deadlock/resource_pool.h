@@ -0,0 +1,95 @@
+#pragma once
+#include "edge_parser.h"
+#include "find_deadlock.h"
+#include "graph.h"
+#include <string>
+#include <vector>
+
+/// per resource type, the processes sorted by how many instances of it they
+/// demand (their outstanding request, or their remaining need); a change of
+/// one demand moves one process within one list, in O(n)
+class DemandIndex {
+    std::vector<std::vector<int>> value;   // value[r][p] = demand of p for r
+    std::vector<std::vector<int>> order;   // order[r] = processes by value[r]
+    std::vector<std::vector<int>> pos;     // pos[r][p] = index of p in order[r]
+
+public:
+    void add_type(int n_procs);
+    void add_proc();
+    void set(int r, int p, int v);
+    int get(int r, int p) const { return value[r][p]; }
+    int at(int r, int i) const { return order[r][i]; }
+};
+
+/// state of a system of processes sharing resource types with several
+/// instances each, as in the deadlock detection and avoidance algorithms
+/// of Silberschatz et al.: the Available vector and the Allocation,
+/// Request and Max (claim) matrices, stored by resource type
+///
+/// every event updates the matrices in O(1) and the demand indices in O(n),
+/// and detect() / is_safe() run the reduction in O(m n) using the indices,
+/// rather than the textbook O(m n^2) rescans
+class ResourcePool {
+    int n_types = 0, n_procs = 0;
+    std::vector<int> total, available;
+    std::vector<std::vector<int>> alloc, claim;   // [r][p]
+    std::vector<int> held;                        // per p, types with alloc > 0
+    DemandIndex requests, needs;
+
+    // scratch space of reduce()
+    std::vector<int> work, next, pending, queue;
+    std::vector<char> done;
+
+    void set_alloc(int r, int p, int v);
+    int reduce(const DemandIndex & demand, bool skip_idle);
+
+public:
+    /// adds a resource type with n instances, returns its id
+    int add_type(int n);
+    /// changes the number of instances of type r to n; returns false, and
+    /// does nothing, if more than n are allocated
+    bool set_instances(int r, int n);
+    /// adds a process that holds, requests and claims nothing, returns its id
+    int add_proc();
+    int types() const { return n_types; }
+    int procs() const { return n_procs; }
+
+    /// process p asks for k more instances of type r
+    void request(int p, int r, int k);
+    /// allocates k instances of type r to p (releases them if k < 0),
+    /// which also satisfies up to k of its outstanding request for r;
+    /// returns false, and does nothing, if there are not enough instances
+    bool allocate(int p, int r, int k);
+    /// sets the claim of p on type r; returns false if p already holds more
+    bool set_claim(int p, int r, int k);
+    /// true if p may hold k more instances of type r without exceeding its claim
+    bool within_claim(int p, int r, int k) const { return alloc[r][p] + k <= claim[r][p]; }
+
+    /// detection: the processes that can never finish, given that every
+    /// process holding something returns it once its request is granted
+    std::vector<int> detect();
+    /// avoidance: true if all processes can finish even if every one of them
+    /// asks for the rest of its claim
+    bool is_safe();
+    /// Banker's algorithm: grants p k instances of type r if they are free,
+    /// within its claim and leave the system safe; otherwise changes nothing
+    bool try_grant(int p, int r, int k);
+};
+
+/// multi-instance version of find_deadlock(): replays the events and returns
+/// the index of the first event after which some processes are deadlocked,
+/// and their names; index = -1 if the events never deadlock
+Result find_deadlock_multi(const std::vector<ResourceEvent> & events);
+
+/// outcome of replaying a trace under the Banker's algorithm
+struct BankerResult {
+    int granted = 0;     // requests granted when made or when retried later
+    int deferred = 0;    // requests that had to wait (possibly forever)
+    int rejected = 0;    // requests beyond the claim, or releases of more than held
+    std::vector<std::string> waiting;   // processes still waiting at the end
+};
+
+/// replays the events under the Banker's algorithm: every request (either
+/// arrow with a positive count) is granted only if the state stays safe,
+/// otherwise it waits and is retried, in order, after every release
+BankerResult run_banker(const std::vector<ResourceEvent> & events);
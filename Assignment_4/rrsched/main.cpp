@@ -5,7 +5,14 @@
 /// DO NOT EDIT THIS FILE. DO NOT SUBMIT THIS FILE FOR GRADING.
 
 #include "common.h"
+#include "metrics.h"
+#include "multicore.h"
+#include "policies.h"
 #include "scheduler.h"
+#include "seqfile.h"
+#include "simulate_rr.h"
+#include "sweep.h"
+#include "trace.h"
 #include <algorithm>
 #include <cassert>
 #include <cstdlib>
@@ -14,6 +21,7 @@
 #include <memory>
 #include <numeric>
 #include <set>
+#include <thread>
 #include <vector>
 
 using VS = std::vector<std::string>;
@@ -41,7 +49,63 @@ static void print_procs(const std::vector<Process> & procs, int indent = 0)
                  "----------------+\n";
 }
 
-static int run_sched(int64_t quantum, int64_t max_seq_len)
+static void print_seq(const std::string & name, const std::vector<int> & seq)
+{
+    std::cout << name << " = [";
+    bool comma = false;
+    for (auto p : seq) {
+        if( comma) std::cout << ","; else comma = true;
+        std::cout << p;
+    }
+    std::cout << "]\n";
+}
+
+static void print_metrics(const Metrics & m)
+{
+    auto row = [](const char * name, const TimeStats & s) {
+        std::cout << "| " << std::setw(10) << std::left << name << std::right << std::fixed
+                  << std::setprecision(1) << " | " << std::setw(16) << s.mean << " | "
+                  << std::setw(16) << s.p50 << " | " << std::setw(16) << s.p95 << " | "
+                  << std::setw(16) << s.p99 << " |\n";
+    };
+    std::string line = "+------------+------------------+------------------+------------------+"
+                       "------------------+\n";
+    std::cout << line
+              << "|            |             Mean |              p50 |              p95 |"
+                 "              p99 |\n"
+              << line;
+    row("Turnaround", m.turnaround);
+    row("Waiting", m.waiting);
+    row("Response", m.response);
+    std::cout << line;
+    std::cout << "Context switches : " << m.switches << "\n"
+              << "CPU utilization  : " << std::setprecision(2) << 100 * m.utilization << "%\n"
+              << "Jain's fairness  : " << std::setprecision(4) << m.fairness << "\n";
+}
+
+static void print_sweep(const SweepRange & range, const std::vector<Metrics> & results)
+{
+    std::string line = "+--------------+--------------+--------------+--------------+--------------+"
+                       "--------------+--------------+--------------+---------+----------+\n";
+    std::cout << line
+              << "|      Quantum |   Turnaround |          p99 |      Waiting |          p99 |"
+                 "     Response |          p99 |     Switches |    Util | Fairness |\n"
+              << line << std::fixed;
+    for (size_t i = 0; i < results.size(); i++) {
+        const Metrics & m = results[i];
+        std::cout << std::setprecision(1) << "| " << std::setw(12) << range.quantum(i) << " | "
+                  << std::setw(12) << m.turnaround.mean << " | " << std::setw(12)
+                  << m.turnaround.p99 << " | " << std::setw(12) << m.waiting.mean << " | "
+                  << std::setw(12) << m.waiting.p99 << " | " << std::setw(12) << m.response.mean
+                  << " | " << std::setw(12) << m.response.p99 << " | " << std::setw(12)
+                  << m.switches << " | " << std::setprecision(2) << std::setw(6)
+                  << 100 * m.utilization << "% | " << std::setprecision(4) << std::setw(8)
+                  << m.fairness << " |\n";
+    }
+    std::cout << line;
+}
+
+static std::vector<Process> read_processes(PolicyConfig & config)
 {
     std::cout << "Reading in lines from stdin...\n";
 
@@ -56,61 +120,297 @@ static int run_sched(int64_t quantum, int64_t max_seq_len)
         auto toks = split(line);
         if (toks.size() == 0) continue;
         try {
-            if (toks.size() != 2) throw fatal_error() << "need 2 ints per line";
+            if (toks.size() != 2 && toks.size() != 3)
+                throw fatal_error() << "need 2 or 3 ints per line";
             Process p;
             p.id = processes.size();
             p.arrival = std::stoll(toks[0]);
             p.burst = std::stoll(toks[1]);
+            // the optional third int is the priority or the number of tickets
+            config.weights.resize(processes.size(), 1);
+            config.weights.push_back(toks.size() == 3 ? std::stoll(toks[2]) : 1);
             processes.push_back(p);
         } catch (std::exception & e) {
             std::cout << "Error on line " << line_no << ": " << e.what() << "\n";
             exit(-1);
         }
     }
+    return processes;
+}
 
+// reads the processes from the trace file, if one is given, or else from stdin
+static std::vector<Process> load_processes(PolicyConfig & config, const std::string & trace)
+{
+    if (trace.empty())
+        return read_processes(config);
+    std::vector<Process> processes = TraceFile(trace).processes();
+    config.weights.assign(processes.size(), 1);
+    return processes;
+}
+
+static int run_convert(const std::string & path)
+{
+    std::cout << "Converting lines from stdin to " << path << "...\n";
+    Timer timer;
+    size_t n = convert_trace(stdin, path);
+    std::cout << "Wrote " << n << " processes in " << std::fixed << std::setprecision(4)
+              << timer.elapsed() << "s\n";
+    return 0;
+}
+
+// prints the records of a sequence file, one per line, with the time each
+// starts at
+static int run_print_seq(const std::string & path)
+{
+    FILE * in = fopen(path.c_str(), "rb");
+    if (!in)
+        throw fatal_error() << "cannot open " << path;
+    std::unique_ptr<FILE, int (*)(FILE *)> closer(in, fclose);
+    int64_t time = 0;
+    read_seq(
+        in,
+        [&](int id, int64_t duration) {
+            std::cout << time << " " << id << " " << duration << "\n";
+            time += duration;
+        },
+        [&](int64_t m, int64_t times, int64_t period) {
+            std::cout << time << " repeat " << m << " " << times << "\n";
+            time += period * times;
+        });
+    return 0;
+}
+
+// the sink writing the execution sequence to the file at path, if any
+static SeqSink seq_sink(std::unique_ptr<SeqWriter> & writer, const std::string & path)
+{
+    if (path.empty())
+        return nullptr;
+    writer.reset(new SeqWriter(path));
+    SeqWriter * w = writer.get();
+    return [w](const int * ids, int n, int64_t duration, int64_t times) {
+        w->add(ids, n, duration, times);
+    };
+}
+
+static void close_seq(std::unique_ptr<SeqWriter> & writer, const std::string & path)
+{
+    if (!writer)
+        return;
+    writer->close();
+    std::cout << "Wrote " << writer->runs() << " runs of the sequence to " << path << "\n";
+}
+
+// round-robin on one core straight from the mapped trace, without a
+// vector<Process>; the processes are not printed, as traces can be huge
+static int run_trace(
+    int64_t quantum, int64_t max_seq_len, const std::string & path, const std::string & seq_out)
+{
+    TraceFile trace(path);
+    std::vector<int64_t> start_time, finish_time;
+    std::vector<int> seq;
+    int64_t switches = 0;
+    std::unique_ptr<SeqWriter> writer;
+    SeqSink sink = seq_sink(writer, seq_out);
     std::cout << "Running simulate_rr(q=" << quantum << ",maxs=" << max_seq_len << ",procs=["
-              << processes.size() << "])\n";
+              << trace.size() << "]) on " << path << "\n";
+    Timer timer;
+    simulate_rr(quantum, max_seq_len, trace.records(), trace.size(), start_time, finish_time, seq,
+        &switches, sink);
+    close_seq(writer, seq_out);
+    std::cout << "Elapsed time  : " << std::fixed << std::setprecision(4) << timer.elapsed()
+              << "s\n\n";
+    print_seq("seq", seq);
+    print_metrics(
+        compute_metrics(trace.records(), trace.size(), start_time, finish_time, switches));
+    return 0;
+}
+
+static int run_sweep(
+    PolicyConfig & config, const SweepRange & range, int n_threads, const std::string & trace)
+{
+    const std::vector<Process> processes = load_processes(config, trace);
+    std::cout << "Running simulate_rr(q=" << range.first << ".." << range.last << " step "
+              << range.step << ",procs=[" << processes.size() << "]) on " << n_threads
+              << " threads\n";
+    Timer timer;
+    std::vector<Metrics> results = sweep_rr(processes, range, n_threads);
+    std::cout << "Elapsed time  : " << std::fixed << std::setprecision(4) << timer.elapsed()
+              << "s\n\n";
+    print_sweep(range, results);
+    return 0;
+}
+
+static int run_sched(PolicyConfig & config, const MulticoreConfig & mc, int64_t max_seq_len,
+    const std::string & trace, const std::string & seq_out)
+{
+    std::vector<Process> processes = load_processes(config, trace);
+    std::unique_ptr<SeqWriter> writer;
+    SeqSink sink = seq_sink(writer, seq_out);
+
     std::vector<int> seq { -2, 1000000, 5000 };
+    std::vector<std::vector<int>> seqs;
+    int64_t switches = 0;
     Timer timer;
-    simulate_rr(quantum, max_seq_len, processes, seq);
+    if (mc.cores > 1) {
+        std::cout << "Running simulate_rr_multicore(q=" << mc.quantum << ",cores=" << mc.cores
+                  << ",migration=" << mc.migration_cost << ",maxs=" << max_seq_len
+                  << ",procs=[" << processes.size() << "])\n";
+        simulate_rr_multicore(mc, max_seq_len, processes, seqs, &switches);
+    } else if (config.policy == Policy::RR) {
+        std::cout << "Running simulate_rr(q=" << config.quantum << ",maxs=" << max_seq_len
+                  << ",procs=[" << processes.size() << "])\n";
+        simulate_rr(config.quantum, max_seq_len, processes, seq, &switches, sink);
+        close_seq(writer, seq_out);
+    } else {
+        std::cout << "Running simulate_policy(q=" << config.quantum << ",maxs=" << max_seq_len
+                  << ",procs=[" << processes.size() << "])\n";
+        simulate_policy(config, max_seq_len, processes, seq, &switches);
+    }
     std::cout << "Elapsed time  : " << std::fixed << std::setprecision(4) << timer.elapsed()
               << "s\n\n";
-    std::cout << "seq = [";
-    bool comma = false;
-    for (auto p : seq) {
-        if( comma) std::cout << ","; else comma = true;
-        std::cout << p;
+    if (mc.cores > 1) {
+        for (size_t c = 0; c < seqs.size(); c++)
+            print_seq("seq[" + std::to_string(c) + "]", seqs[c]);
+    } else {
+        print_seq("seq", seq);
     }
-    std::cout << "]\n";
     print_procs(processes);
+    print_metrics(compute_metrics(processes, switches, mc.cores));
 
     return 0;
 }
+// the sweep keeps the metrics of every quantum, so it is limited to this
+// many of them
+static constexpr size_t max_sweep_quanta = 100000;
+
 static int usage(const std::string & pname)
 {
     std::cout << "Usage:\n"
-              << "    " << pname << " quantum max_seq_len\n";
+              << "    " << pname << " [options] quantum max_seq_len\n"
+              << "    " << pname << " --sweep q1:q2[:step] [--threads n]\n"
+              << "    " << pname << " --convert file.bin\n"
+              << "    " << pname << " --print-seq file\n"
+              << "Options:\n"
+              << "    --policy name  rr (default), fcfs, sjf, srtf, mlfq, priority,\n"
+              << "                   lottery or stride\n"
+              << "    --levels n     mlfq: number of levels (default 3)\n"
+              << "    --boost t      mlfq: move everyone to the top level every t\n"
+              << "    --aging t      priority: waiting t is worth one priority level\n"
+              << "    --seed s       lottery: random seed\n"
+              << "    --cores n      rr on n cores, each with its own ready queue\n"
+              << "    --migration t  cores: time to move a stolen process (default 0)\n"
+              << "    --sweep range  rr with every quantum of the range, metrics only,\n"
+              << "                   up to " << max_sweep_quanta << " quanta\n"
+              << "    --threads n    sweep: number of threads (default: all cores)\n"
+              << "    --trace file   read the processes from a binary trace file\n"
+              << "    --convert file convert the input to a binary trace file\n"
+              << "    --seq-out file rr on one core: also write the whole execution\n"
+              << "                   sequence to a file, as runs of id and length\n"
+              << "    --print-seq f  print the runs of a sequence file as text\n"
+              << "Input lines are 'arrival burst [weight]', where weight is the\n"
+              << "priority (lower runs first) or the number of tickets. Trace\n"
+              << "files keep no weights.\n";
     return -1;
 }
 
 static int cppmain(const VS & args)
 {
     // parse arguments
-    if (args.size() != 3)
-        return usage(args[0]);
-
-    int64_t quantum, max_seq_len;
+    PolicyConfig config;
+    MulticoreConfig mc;
+    SweepRange range;
+    bool sweep = false;
+    std::string trace, convert, seq_out, seq_in;
+    int n_threads = std::max(1u, std::thread::hardware_concurrency());
+    VS positional;
+    int64_t max_seq_len = 0;
     try {
-        quantum = std::stoll(args[1]);
-        max_seq_len = std::stoll(args[2]);
+        for (size_t i = 1; i < args.size(); i++) {
+            bool has_value = i + 1 < args.size();
+            if (args[i] == "--policy" && has_value) {
+                if (!parse_policy(args[++i], config.policy))
+                    return usage(args[0]);
+            } else if (args[i] == "--levels" && has_value)
+                config.mlfq_levels = std::stoi(args[++i]);
+            else if (args[i] == "--boost" && has_value)
+                config.mlfq_boost = std::stoll(args[++i]);
+            else if (args[i] == "--aging" && has_value)
+                config.aging = std::stoll(args[++i]);
+            else if (args[i] == "--seed" && has_value)
+                config.seed = std::stoull(args[++i]);
+            else if (args[i] == "--cores" && has_value)
+                mc.cores = std::stoi(args[++i]);
+            else if (args[i] == "--migration" && has_value)
+                mc.migration_cost = std::stoll(args[++i]);
+            else if (args[i] == "--sweep" && has_value) {
+                if (!parse_sweep(args[++i], range))
+                    return usage(args[0]);
+                sweep = true;
+            } else if (args[i] == "--threads" && has_value)
+                n_threads = std::stoi(args[++i]);
+            else if (args[i] == "--trace" && has_value)
+                trace = args[++i];
+            else if (args[i] == "--convert" && has_value)
+                convert = args[++i];
+            else if (args[i] == "--seq-out" && has_value)
+                seq_out = args[++i];
+            else if (args[i] == "--print-seq" && has_value)
+                seq_in = args[++i];
+            else
+                positional.push_back(args[i]);
+        }
+        if (!seq_in.empty()) {
+            if (args.size() != 3)
+                return usage(args[0]);
+        } else if (!convert.empty()) {
+            if (!positional.empty() || sweep || !trace.empty() || !seq_out.empty())
+                return usage(args[0]);
+        } else if (sweep) {
+            // the sweep only runs round-robin on one core
+            if (!positional.empty() || config.policy != Policy::RR || mc.cores != 1
+                || n_threads <= 0 || !seq_out.empty())
+                return usage(args[0]);
+            if (range.size() > max_sweep_quanta) {
+                std::cout << "Too many quanta to sweep, at most " << max_sweep_quanta
+                          << " are allowed.\n";
+                return usage(args[0]);
+            }
+        } else {
+            if (positional.size() != 2)
+                return usage(args[0]);
+            config.quantum = std::stoll(positional[0]);
+            max_seq_len = std::stoll(positional[1]);
+        }
     } catch (...) {
         std::cout << "Could not parse command line arguments.\n";
         return usage(args[0]);
     }
-    return run_sched(quantum, max_seq_len);
+    if (!seq_in.empty())
+        return run_print_seq(seq_in);
+    if (!convert.empty())
+        return run_convert(convert);
+    if (sweep)
+        return run_sweep(config, range, n_threads, trace);
+    mc.quantum = config.quantum;
+    if (config.quantum <= 0 || config.mlfq_levels <= 0 || mc.cores <= 0 || mc.migration_cost < 0)
+        return usage(args[0]);
+    // only round-robin runs on several cores
+    if (mc.cores > 1 && config.policy != Policy::RR)
+        return usage(args[0]);
+    // only round-robin on one core streams its sequence
+    if (!seq_out.empty() && (mc.cores > 1 || config.policy != Policy::RR))
+        return usage(args[0]);
+    if (!trace.empty() && mc.cores == 1 && config.policy == Policy::RR)
+        return run_trace(config.quantum, max_seq_len, trace, seq_out);
+    return run_sched(config, mc, max_seq_len, trace, seq_out);
 }
 
 int main(int argc, char ** argv)
 {
-    return cppmain({ argv + 0, argv + argc });
+    try {
+        return cppmain({ argv + 0, argv + argc });
+    } catch (fatal_error & e) {
+        std::cout << e.what() << "\n";
+        return -1;
+    }
 }
@@ -0,0 +1,154 @@
+#include "metrics.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// relative accuracy of QuantileSketch, and the growth of its buckets
+constexpr double accuracy = 0.01;
+const double growth = (1 + accuracy) / (1 - accuracy);
+const double log_growth = std::log(growth);
+
+} // anonymous namespace
+
+void QuantileSketch::add(int64_t value)
+{
+    if (n == 0 || value < min)
+        min = value;
+    if (n == 0 || value > max)
+        max = value;
+    n++;
+    if (value <= 0) {
+        zeros++;
+        return;
+    }
+    size_t k = std::max(0.0, std::ceil(std::log(double(value)) / log_growth));
+    if (k >= buckets.size())
+        buckets.resize(k + 1, 0);
+    buckets[k]++;
+}
+
+void QuantileSketch::merge(const QuantileSketch & other)
+{
+    if (other.n == 0)
+        return;
+    min = n == 0 ? other.min : std::min(min, other.min);
+    max = n == 0 ? other.max : std::max(max, other.max);
+    n += other.n;
+    zeros += other.zeros;
+    if (other.buckets.size() > buckets.size())
+        buckets.resize(other.buckets.size(), 0);
+    for (size_t k = 0; k < other.buckets.size(); k++)
+        buckets[k] += other.buckets[k];
+}
+
+double QuantileSketch::quantile(double q) const
+{
+    if (n == 0)
+        return 0;
+    // nearest rank: the smallest value with at least q * n values up to it
+    int64_t rank = std::max<int64_t>(0, std::ceil(q * n) - 1);
+    if (rank < zeros)
+        return min;
+    int64_t seen = zeros;
+    for (size_t k = 0; k < buckets.size(); k++) {
+        seen += buckets[k];
+        if (rank < seen) {
+            // the only integer in the bucket, or else the middle of the
+            // bucket, relative to its bounds
+            double upper = std::pow(growth, k);
+            if (std::floor(upper) == std::floor(upper / growth) + 1)
+                return std::floor(upper);
+            double estimate = 2 * upper / (growth + 1);
+            return std::clamp(estimate, double(min), double(max));
+        }
+    }
+    return max;
+}
+
+namespace {
+
+// process i arrived at arrival(i), needed burst(i), and started and
+// finished at start(i) and finish(i)
+template <typename Arrival, typename Burst, typename Start, typename Finish>
+Metrics metrics_of(size_t n_procs, Arrival arrival, Burst burst, Start start, Finish finish,
+    int64_t switches, int cores)
+{
+    Metrics m;
+    m.switches = switches;
+    if (n_procs == 0)
+        return m;
+
+    QuantileSketch turnaround, waiting, response;
+    double sum_turnaround = 0, sum_waiting = 0, sum_response = 0;
+    double sum_share = 0, sum_share2 = 0, busy = 0;
+    int64_t first = arrival(0), last = finish(0);
+    for (size_t i = 0; i < n_procs; i++) {
+        int64_t t = finish(i) - arrival(i);
+        int64_t w = t - burst(i);
+        int64_t r = start(i) - arrival(i);
+        turnaround.add(t);
+        waiting.add(w);
+        response.add(r);
+        sum_turnaround += t;
+        sum_waiting += w;
+        sum_response += r;
+        double share = double(burst(i)) / t;
+        sum_share += share;
+        sum_share2 += share * share;
+        busy += burst(i);
+        first = std::min(first, arrival(i));
+        last = std::max(last, finish(i));
+    }
+
+    double n = n_procs;
+    auto stats = [&](const QuantileSketch & sketch, double sum) {
+        return TimeStats { sum / n, sketch.quantile(0.50), sketch.quantile(0.95),
+            sketch.quantile(0.99) };
+    };
+    m.turnaround = stats(turnaround, sum_turnaround);
+    m.waiting = stats(waiting, sum_waiting);
+    m.response = stats(response, sum_response);
+    if (last > first)
+        m.utilization = busy / (double(std::max(1, cores)) * (last - first));
+    m.fairness = sum_share * sum_share / (n * sum_share2);
+    return m;
+}
+
+} // anonymous namespace
+
+Metrics compute_metrics(const std::vector<Process> & processes, int64_t switches, int cores)
+{
+    return metrics_of(
+        processes.size(), [&](size_t i) { return processes[i].arrival; },
+        [&](size_t i) { return processes[i].burst; },
+        [&](size_t i) { return processes[i].start_time; },
+        [&](size_t i) { return processes[i].finish_time; }, switches, cores);
+}
+
+Metrics compute_metrics(
+    const std::vector<Process> & processes,
+    const std::vector<int64_t> & start_time,
+    const std::vector<int64_t> & finish_time,
+    int64_t switches,
+    int cores)
+{
+    return metrics_of(
+        processes.size(), [&](size_t i) { return processes[i].arrival; },
+        [&](size_t i) { return processes[i].burst; }, [&](size_t i) { return start_time[i]; },
+        [&](size_t i) { return finish_time[i]; }, switches, cores);
+}
+
+Metrics compute_metrics(
+    const int64_t * records,
+    size_t n,
+    const std::vector<int64_t> & start_time,
+    const std::vector<int64_t> & finish_time,
+    int64_t switches,
+    int cores)
+{
+    return metrics_of(
+        n, [&](size_t i) { return records[2 * i]; }, [&](size_t i) { return records[2 * i + 1]; },
+        [&](size_t i) { return start_time[i]; }, [&](size_t i) { return finish_time[i]; },
+        switches, cores);
+}
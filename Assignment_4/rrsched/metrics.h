@@ -0,0 +1,65 @@
+#pragma once
+#include "scheduler.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// streaming quantiles of non-negative integers, within 1% of the exact
+/// ones
+///
+/// the values are counted in buckets whose bounds grow by a constant
+/// factor, so adding a value is O(1), and the memory only depends on the
+/// range of the values, not on how many there are
+class QuantileSketch {
+public:
+    void add(int64_t value);
+    void merge(const QuantileSketch & other);
+    int64_t count() const { return n; }
+    /// the q-quantile, for q in [0, 1], by the nearest rank
+    double quantile(double q) const;
+
+private:
+    // buckets[k] counts the values in (growth^(k-1), growth^k]
+    std::vector<int64_t> buckets;
+    int64_t zeros = 0, n = 0;
+    int64_t min = 0, max = 0;
+};
+
+/// mean and percentiles of one time measured per process
+struct TimeStats {
+    double mean = 0, p50 = 0, p95 = 0, p99 = 0;
+};
+
+/// aggregated results of one simulation
+struct Metrics {
+    TimeStats turnaround;       // finish - arrival
+    TimeStats waiting;          // turnaround - burst
+    TimeStats response;         // start - arrival
+    int64_t switches = 0;       // context switches
+    // bursts / (cores * (last finish - first arrival))
+    double utilization = 0;
+    // Jain's fairness index of burst / turnaround, the share of its time in
+    // the system a process was running: 1 if all shares are equal, down to
+    // 1/n if a single process got everything
+    double fairness = 1;
+};
+
+/// computes the metrics of simulated processes in a single pass over them
+Metrics compute_metrics(const std::vector<Process> & processes, int64_t switches, int cores = 1);
+
+/// the same, with the start and finish times of the processes given apart
+Metrics compute_metrics(
+    const std::vector<Process> & processes,
+    const std::vector<int64_t> & start_time,
+    const std::vector<int64_t> & finish_time,
+    int64_t switches,
+    int cores = 1);
+
+/// the same, for n processes given as (arrival, burst) pairs in records
+Metrics compute_metrics(
+    const int64_t * records,
+    size_t n,
+    const std::vector<int64_t> & start_time,
+    const std::vector<int64_t> & finish_time,
+    int64_t switches,
+    int cores = 1);
@@ -0,0 +1,347 @@
+#include "multicore.h"
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <queue>
+#include <utility>
+
+namespace {
+
+struct Core {
+    std::deque<int> queue;
+    int running = -1;          // process on the core, -1 = none
+    int64_t slice = 0;         // how much of its burst the process uses now
+    int64_t begin = 0;         // when the process started using it
+    int64_t work = 0;          // bursts left of all processes on the core
+    int64_t quiet = 0;         // time slices since the queue last changed
+    int unstarted = 0;         // processes in the queue that never ran
+    int64_t horizon = -1;      // see fast_forward()
+    int64_t idle_since = 0;    // when the core last had no process
+    int last_run = -1;         // what ran last, -1 = the core idled
+    int load() const { return queue.size() + (running >= 0); }
+};
+
+// Fenwick tree counting the processes still in a ready queue, by position;
+// the same as the one in scheduler.cpp, which has to stay self-contained
+struct Fenwick {
+    std::vector<int> tree;
+    explicit Fenwick(int n)
+        : tree(n + 1, 0)
+    {
+        for (int i = 1; i <= n; i++) {
+            tree[i]++;
+            if (i + (i & -i) <= n)
+                tree[i + (i & -i)] += tree[i];
+        }
+    }
+    void remove(int pos)
+    {
+        for (int i = pos + 1; i < int(tree.size()); i += i & -i)
+            tree[i]--;
+    }
+    // number of entries at positions < pos
+    int count_before(int pos) const
+    {
+        int c = 0;
+        for (int i = pos; i > 0; i -= i & -i)
+            c += tree[i];
+        return c;
+    }
+};
+
+} // anonymous namespace
+
+// Event-driven like simulate_rr(): the events are the ends of the time
+// slices of the cores, kept in a min-heap, and the arrivals. All events at
+// the same time t are handled in three phases, which with one core gives
+// exactly the order of simulate_rr():
+//   1. every core whose slice ends at t puts its process back in its queue,
+//      unless it finished,
+//   2. the processes arriving at t are queued on the least loaded cores,
+//   3. every core without a process starts the next one from its queue,
+//      and then the cores with empty queues steal one.
+// A process alone on its core runs all of its quanta up to the next arrival
+// in one slice: before that, nothing can join its queue, and nothing can
+// steal it, since only waiting processes are stolen.
+//
+// Cores only interact at arrivals and when one of them runs out of work,
+// which is no earlier than its start plus the bursts left on it. Before
+// the first of these, the horizon, every core is on its own. Once all
+// processes in its queue have started, the completions before the horizon
+// are computed if seqs[c] is full, and whole rounds are skipped, as in
+// simulate_rr(), and then the part of a round left before the horizon too.
+// That is tried again after every round of the queue, or when the horizon
+// moves.
+// The last process of a core is never finished that way, so that a core
+// only runs out of work at one of its own events.
+void simulate_rr_multicore(
+    const MulticoreConfig & config,
+    int64_t max_seq_len,
+    std::vector<Process> & processes,
+    std::vector<std::vector<int>> & seqs,
+    int64_t * switches)
+{
+    int n = processes.size();
+    int n_cores = std::max(1, config.cores);
+    int64_t quantum = config.quantum;
+    std::vector<Core> cores(n_cores);
+    seqs.assign(n_cores, {});
+
+    // indices of processes by arrival, ties broken by input order
+    std::vector<int> by_arrival(n);
+    std::iota(by_arrival.begin(), by_arrival.end(), 0);
+    std::stable_sort(by_arrival.begin(), by_arrival.end(), [&](int a, int b) {
+        return processes[a].arrival < processes[b].arrival;
+    });
+
+    std::vector<int64_t> remaining(n);
+    for (int i = 0; i < n; i++) {
+        remaining[i] = processes[i].burst;
+        processes[i].start_time = -1;
+        processes[i].finish_time = -1;
+    }
+
+    // appends id to the compressed sequence of core c, up to max_seq_len entries
+    auto append = [&](int c, int id) {
+        auto & seq = seqs[c];
+        if (int64_t(seq.size()) < max_seq_len && (seq.empty() || seq.back() != id))
+            seq.push_back(id);
+    };
+    int64_t n_switches = 0;
+    auto record = [&](int c, int id) {
+        int & last_run = cores[c].last_run;
+        n_switches += id >= 0 && last_run >= 0 && id != last_run;
+        last_run = id;
+        append(c, id);
+    };
+
+    using Event = std::pair<int64_t, int>;   // (end of slice, core)
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+    int next_arrival = 0;
+
+    // computes the completions on core c, and skips as many time slices as
+    // possible, before the horizon; returns the time after them
+    auto fast_forward = [&](int c, int64_t t) {
+        Core & core = cores[c];
+        auto & ready = core.queue;
+        int64_t n_ready = ready.size();
+        if (n_ready < 2 || core.unstarted > 0)
+            return t;
+        int64_t horizon = next_arrival < n ? processes[by_arrival[next_arrival]].arrival
+                                           : std::numeric_limits<int64_t>::max();
+        for (int d = 0; d < n_cores; d++) {
+            if (d == c)
+                continue;
+            int64_t start = cores[d].running >= 0 ? cores[d].begin : t;
+            horizon = std::min(horizon, start + cores[d].work);
+        }
+        if (core.quiet < n_ready && horizon == core.horizon)
+            return t;
+        core.quiet = 0;
+        core.horizon = horizon;
+        // everything ends strictly before the horizon, so that the order of
+        // the events at that time stays the same
+        if (horizon <= t)
+            return t;
+
+        // the first completion, of the first process among those needing
+        // the fewest quanta
+        int64_t min_remaining = remaining[ready.front()];
+        int64_t first_finish = std::numeric_limits<int64_t>::max();
+        for (int pos = 0; pos < n_ready; pos++) {
+            int64_t rem = remaining[ready[pos]];
+            min_remaining = std::min(min_remaining, rem);
+            first_finish = std::min(first_finish,
+                t + rem + (rem - 1) / quantum * quantum * (n_ready - 1) + quantum * pos);
+        }
+
+        if (int64_t(seqs[c].size()) >= max_seq_len && first_finish < horizon) {
+            std::vector<int64_t> rounds(n_ready);
+            std::vector<int> order(n_ready);
+            for (int pos = 0; pos < n_ready; pos++) {
+                rounds[pos] = (remaining[ready[pos]] - 1) / quantum + 1;
+                order[pos] = pos;
+            }
+            std::sort(order.begin(), order.end(), [&](int a, int b) {
+                return rounds[a] < rounds[b] || (rounds[a] == rounds[b] && a < b);
+            });
+            Fenwick left(n_ready);
+            int64_t finished_bursts = 0, n_left = n_ready;
+            // time slices until the last completion, all of them switches
+            int64_t slices = 0;
+            int last = -1;
+            for (int pos : order) {
+                int j = ready[pos];
+                int64_t finish = t + finished_bursts + remaining[j]
+                    + (rounds[pos] - 1) * quantum * (n_left - 1)
+                    + quantum * left.count_before(pos);
+                if (n_left == 1 || finish >= horizon)
+                    break;
+                processes[j].finish_time = finish;
+                slices += rounds[pos];
+                finished_bursts += remaining[j];
+                left.remove(pos);
+                n_left--;
+                last = pos;
+            }
+            if (last >= 0) {
+                // rebuild the queue as of the last completion: it continues
+                // after that process, and those before it ran one more round
+                int64_t time = processes[ready[last]].finish_time;
+                int64_t served = (rounds[last] - 1) * quantum;
+                std::deque<int> rest;
+                core.work = 0;
+                for (int k = 1; k < n_ready; k++) {
+                    int pos = (last + k) % n_ready;
+                    int j = ready[pos];
+                    if (processes[j].finish_time >= 0)
+                        continue;
+                    remaining[j] -= served + (pos < last ? quantum : 0);
+                    slices += rounds[last] - 1 + (pos < last);
+                    core.work += remaining[j];
+                    rest.push_back(j);
+                }
+                n_switches += slices;
+                core.last_run = processes[ready[last]].id;
+                ready.swap(rest);
+                t = time;
+                n_ready = ready.size();
+                core.idle_since = t;
+                if (n_ready < 2)
+                    return t;
+                min_remaining = remaining[ready.front()];
+                for (int j : ready)
+                    min_remaining = std::min(min_remaining, remaining[j]);
+            }
+        }
+
+        // k whole rounds and then r more time slices, as many as fit before
+        // the horizon without a completion
+        int64_t slices = (horizon - t - 1) / quantum;
+        int64_t k = std::min((min_remaining - 1) / quantum, slices / n_ready);
+        int64_t r = 0;
+        while (r < std::min(n_ready, slices - k * n_ready) && remaining[ready[r]] > (k + 1) * quantum)
+            r++;
+        if (k == 0 && r == 0)
+            return t;
+        for (int64_t i = 0; i < k && int64_t(seqs[c].size()) < max_seq_len; i++)
+            for (int j : ready)
+                append(c, processes[j].id);
+        if (k > 0) {
+            n_switches += k * n_ready;
+            core.last_run = processes[ready.back()].id;
+        }
+        for (int64_t pos = 0; pos < n_ready; pos++)
+            remaining[ready[pos]] -= (k + (pos < r)) * quantum;
+        for (int64_t i = 0; i < r; i++) {
+            record(c, processes[ready.front()].id);
+            ready.push_back(ready.front());
+            ready.pop_front();
+        }
+        int64_t skipped = (k * n_ready + r) * quantum;
+        core.work -= skipped;
+        core.idle_since = t + skipped;
+        return core.idle_since;
+    };
+
+    // starts the next process on core c at time t, stealing one if needed
+    auto start_next = [&](int c, int64_t t) {
+        Core & core = cores[c];
+        int i;
+        int64_t delay = 0;
+        if (!core.queue.empty()) {
+            i = core.queue.front();
+            core.queue.pop_front();
+            core.unstarted -= processes[i].start_time < 0;
+        } else {
+            int victim = -1;
+            for (int v = 0; v < n_cores; v++)
+                if (!cores[v].queue.empty()
+                    && (victim < 0 || cores[v].queue.size() > cores[victim].queue.size()))
+                    victim = v;
+            if (victim < 0)
+                return;
+            i = cores[victim].queue.back();
+            cores[victim].queue.pop_back();
+            cores[victim].work -= remaining[i];
+            cores[victim].unstarted -= processes[i].start_time < 0;
+            cores[victim].quiet = 0;
+            core.work += remaining[i];
+            core.quiet = 0;
+            delay = config.migration_cost;
+        }
+        if (core.idle_since < t)
+            record(c, -1);
+        record(c, processes[i].id);
+        int64_t begin = t + delay;
+        if (processes[i].start_time < 0)
+            processes[i].start_time = begin;
+
+        int64_t slice = std::min(quantum, remaining[i]);
+        int64_t until_arrival = next_arrival < n
+            ? processes[by_arrival[next_arrival]].arrival - begin
+            : std::numeric_limits<int64_t>::max();
+        if (core.queue.empty() && until_arrival > 0) {
+            // alone: whole quanta up to the first boundary at or after the
+            // next arrival, or to completion
+            slice = remaining[i];
+            if (next_arrival < n) {
+                int64_t k = (until_arrival - 1) / quantum + 1;
+                if (k <= remaining[i] / quantum)
+                    slice = k * quantum;
+            }
+        }
+        core.running = i;
+        core.slice = slice;
+        core.begin = begin;
+        events.emplace(begin + slice, c);
+    };
+
+    while (next_arrival < n || !events.empty()) {
+        int64_t t = events.empty() ? std::numeric_limits<int64_t>::max() : events.top().first;
+        if (next_arrival < n)
+            t = std::min(t, processes[by_arrival[next_arrival]].arrival);
+
+        // 1. slices ending at t
+        while (!events.empty() && events.top().first == t) {
+            Core & core = cores[events.top().second];
+            events.pop();
+            int i = core.running;
+            remaining[i] -= core.slice;
+            core.work -= core.slice;
+            core.running = -1;
+            core.idle_since = t;
+            if (remaining[i] == 0) {
+                processes[i].finish_time = t;
+                core.quiet = 0;
+            } else {
+                core.queue.push_back(i);
+                core.quiet++;
+            }
+        }
+        // 2. arrivals at t
+        while (next_arrival < n && processes[by_arrival[next_arrival]].arrival == t) {
+            int best = 0;
+            for (int c = 1; c < n_cores; c++)
+                if (cores[c].load() < cores[best].load())
+                    best = c;
+            int i = by_arrival[next_arrival++];
+            cores[best].queue.push_back(i);
+            cores[best].work += remaining[i];
+            cores[best].quiet = 0;
+            cores[best].unstarted++;
+        }
+        // 3. idle cores pick their next process, their own first, so that
+        //    none is stolen from the core it was just preempted on
+        for (int c = 0; c < n_cores; c++)
+            if (cores[c].running < 0 && !cores[c].queue.empty())
+                start_next(c, fast_forward(c, t));
+        for (int c = 0; c < n_cores; c++)
+            if (cores[c].running < 0)
+                start_next(c, t);
+    }
+    if (switches)
+        *switches = n_switches;
+}
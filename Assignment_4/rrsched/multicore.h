@@ -0,0 +1,30 @@
+#pragma once
+#include "scheduler.h"
+#include <cstdint>
+#include <vector>
+
+/// parameters of the multi-core round-robin simulation
+struct MulticoreConfig {
+    int cores = 1;
+    int64_t quantum = 1;
+    // time a core spends moving a process it stole from another core
+    // before the process runs
+    int64_t migration_cost = 0;
+};
+
+/// round-robin on several cores, each with its own ready queue
+///
+/// an arriving process joins the queue of the core with the fewest processes
+/// (running or ready, the lowest index on ties); a core that runs out of
+/// processes steals the last one from the longest queue of another core,
+/// and runs it after migration_cost. The processes are filled in as by
+/// simulate_rr(), and seqs[c] is the sequence of core c in the same format
+/// as seq of simulate_rr(); with a single core the results are the same as
+/// those of simulate_rr(). If switches is not null, it is set to the number
+/// of context switches on all cores
+void simulate_rr_multicore(
+    const MulticoreConfig & config,
+    int64_t max_seq_len,
+    std::vector<Process> & processes,
+    std::vector<std::vector<int>> & seqs,
+    int64_t * switches = nullptr);
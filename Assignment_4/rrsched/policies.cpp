@@ -0,0 +1,379 @@
+#include "policies.h"
+#include "simulate_rr.h"
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <queue>
+#include <random>
+#include <tuple>
+#include <utility>
+
+namespace {
+
+constexpr int64_t no_arrival = std::numeric_limits<int64_t>::max();
+
+/// the ready queue of a policy, which also decides how long the process
+/// it hands out may run
+class ReadyQueue {
+public:
+    virtual ~ReadyQueue() = default;
+    /// adds process i, with remaining burst left, at time now
+    virtual void push(int i, int64_t remaining, int64_t now) = 0;
+    /// removes and returns the process to run next
+    virtual int pop(int64_t now) = 0;
+    /// how long process i may run from now on; alone is set if no other
+    /// process is ready, and until_arrival is the time to the next arrival
+    virtual int64_t slice(int i, int64_t remaining, bool alone, int64_t until_arrival) = 0;
+    /// called when process i leaves the CPU after running for ran
+    virtual void charge(int /*i*/, int64_t /*ran*/) { }
+};
+
+/// how long a process that is alone runs in whole quanta: up to the first
+/// quantum boundary at or after the next arrival, or to its completion;
+/// this saves a pop and push per quantum, and is only used by policies
+/// whose state after k quanta charge() can compute in one step
+int64_t alone_slice(int64_t quantum, int64_t remaining, int64_t until_arrival)
+{
+    if (until_arrival == no_arrival)
+        return remaining;
+    int64_t k = (until_arrival - 1) / quantum + 1;
+    return k <= remaining / quantum ? k * quantum : remaining;
+}
+
+/// time slice of the quantum-based policies
+int64_t quantum_slice(int64_t quantum, int64_t remaining, bool alone, int64_t until_arrival)
+{
+    return alone ? alone_slice(quantum, remaining, until_arrival) : std::min(quantum, remaining);
+}
+
+/// min-heap of (key, push order, process), the push order breaking ties
+/// first come, first served
+class KeyHeap {
+    using Entry = std::tuple<int64_t, int64_t, int>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+    int64_t pushes = 0;
+
+public:
+    void push(int64_t key, int i) { heap.emplace(key, pushes++, i); }
+    int pop()
+    {
+        int i = std::get<2>(heap.top());
+        heap.pop();
+        return i;
+    }
+};
+
+/// first come, first served, every process runs to completion
+class FcfsQueue : public ReadyQueue {
+    std::deque<int> queue;
+
+public:
+    void push(int i, int64_t, int64_t) override { queue.push_back(i); }
+    int pop(int64_t) override
+    {
+        int i = queue.front();
+        queue.pop_front();
+        return i;
+    }
+    int64_t slice(int, int64_t remaining, bool, int64_t) override { return remaining; }
+};
+
+/// shortest job first (non-preemptive), or shortest remaining time first,
+/// where every arrival preempts the running process
+class ShortestQueue : public ReadyQueue {
+    KeyHeap heap;
+    bool preemptive;
+
+public:
+    explicit ShortestQueue(bool preemptive)
+        : preemptive(preemptive)
+    {
+    }
+    void push(int i, int64_t remaining, int64_t) override { heap.push(remaining, i); }
+    int pop(int64_t) override { return heap.pop(); }
+    int64_t slice(int, int64_t remaining, bool, int64_t until_arrival) override
+    {
+        return preemptive ? std::min(remaining, until_arrival) : remaining;
+    }
+};
+
+/// multi-level feedback queue: new processes start at the top level, a
+/// process that uses up its time slice drops one level, and the top
+/// non-empty level runs round-robin
+class MlfqQueue : public ReadyQueue {
+    std::vector<std::deque<int>> levels;
+    std::vector<int> level;     // per process
+    std::vector<char> seen;     // per process, pushed before
+    int64_t quantum, boost, next_boost;
+
+    int64_t level_quantum(int l) const
+    {
+        const int64_t max = std::numeric_limits<int64_t>::max();
+        return quantum > (max >> l) ? max : quantum << l;
+    }
+
+public:
+    MlfqQueue(int n_procs, const PolicyConfig & config)
+        : levels(std::max(1, std::min(config.mlfq_levels, 62)))
+        , level(n_procs, 0)
+        , seen(n_procs, 0)
+        , quantum(config.quantum)
+        , boost(config.mlfq_boost)
+        , next_boost(config.mlfq_boost)
+    {
+    }
+    void push(int i, int64_t, int64_t) override
+    {
+        if (!seen[i]) {
+            seen[i] = 1;
+            level[i] = 0;
+        }
+        levels[level[i]].push_back(i);
+    }
+    int pop(int64_t now) override
+    {
+        if (boost > 0 && now >= next_boost) {
+            // priority boost: everyone back to the top, keeping their order
+            for (size_t l = 1; l < levels.size(); l++) {
+                for (int i : levels[l]) {
+                    level[i] = 0;
+                    levels[0].push_back(i);
+                }
+                levels[l].clear();
+            }
+            next_boost = (now / boost + 1) * boost;
+        }
+        size_t l = 0;
+        while (levels[l].empty())
+            l++;
+        int i = levels[l].front();
+        levels[l].pop_front();
+        return i;
+    }
+    int64_t slice(int i, int64_t remaining, bool alone, int64_t until_arrival) override
+    {
+        int l = level[i];
+        if (!alone || boost > 0)
+            return std::min(remaining, level_quantum(l));
+        // alone: walk down the levels, then stay at the bottom one
+        int64_t ran = 0;
+        while (l + 1 < int(levels.size())) {
+            int64_t q = level_quantum(l);
+            if (remaining - ran <= q)
+                return remaining;
+            ran += q;
+            l++;
+            if (ran >= until_arrival)
+                return ran;
+        }
+        return ran + alone_slice(level_quantum(l), remaining - ran, until_arrival - ran);
+    }
+    void charge(int i, int64_t ran) override
+    {
+        int l = level[i];
+        while (l + 1 < int(levels.size()) && ran >= level_quantum(l)) {
+            ran -= level_quantum(l);
+            l++;
+        }
+        level[i] = l;
+    }
+};
+
+/// priority round-robin with aging: a process that waited `aging` time
+/// units counts as one priority level more urgent. The effective priority
+/// of a process queued at time t0 with priority w is w - (now - t0) / aging,
+/// and since now is the same for every process, ordering by the fixed key
+/// w * aging + t0 gives the same order without ever updating the heap.
+class AgingQueue : public ReadyQueue {
+    KeyHeap heap;
+    const std::vector<int64_t> & weights;
+    int64_t quantum, aging;
+
+public:
+    AgingQueue(const std::vector<int64_t> & weights, const PolicyConfig & config)
+        : weights(weights)
+        , quantum(config.quantum)
+        , aging(config.aging)
+    {
+    }
+    void push(int i, int64_t, int64_t now) override
+    {
+        heap.push(aging > 0 ? weights[i] * aging + now : weights[i], i);
+    }
+    int pop(int64_t) override { return heap.pop(); }
+    int64_t slice(int, int64_t remaining, bool alone, int64_t until_arrival) override
+    {
+        return quantum_slice(quantum, remaining, alone, until_arrival);
+    }
+};
+
+/// lottery scheduling: every quantum goes to a process drawn at random with
+/// probability proportional to its tickets; a Fenwick tree over the tickets
+/// of the ready processes finds the winner in O(log n)
+class LotteryQueue : public ReadyQueue {
+    std::vector<int64_t> tree, tickets;
+    int64_t total = 0;
+    int64_t quantum;
+    std::mt19937_64 rng;
+    int top_bit = 1;
+
+    void add(int i, int64_t v)
+    {
+        total += v;
+        for (int k = i + 1; k < int(tree.size()); k += k & -k)
+            tree[k] += v;
+    }
+
+public:
+    LotteryQueue(const std::vector<int64_t> & weights, const PolicyConfig & config)
+        : tree(weights.size() + 1, 0)
+        , tickets(weights)
+        , quantum(config.quantum)
+        , rng(config.seed)
+    {
+        while (top_bit * 2 < int(tree.size()))
+            top_bit *= 2;
+    }
+    void push(int i, int64_t, int64_t) override
+    {
+        add(i, tickets[i]);
+    }
+    int pop(int64_t) override
+    {
+        // find the process owning the winning ticket by descending the tree
+        int64_t ticket = std::uniform_int_distribution<int64_t>(0, total - 1)(rng);
+        int pos = 0;
+        for (int step = top_bit; step > 0; step /= 2)
+            if (pos + step < int(tree.size()) && tree[pos + step] <= ticket) {
+                pos += step;
+                ticket -= tree[pos];
+            }
+        add(pos, -tickets[pos]);
+        return pos;
+    }
+    int64_t slice(int, int64_t remaining, bool alone, int64_t until_arrival) override
+    {
+        return quantum_slice(quantum, remaining, alone, until_arrival);
+    }
+};
+
+/// stride scheduling: the process with the smallest pass runs next, and
+/// every quantum it runs adds its stride, inversely proportional to its
+/// tickets, to its pass; newcomers start at the pass of the last process
+/// run, so they cannot claim the time before they arrived
+class StrideQueue : public ReadyQueue {
+    static constexpr int64_t stride1 = int64_t(1) << 20;
+    KeyHeap heap;
+    std::vector<int64_t> pass, stride;
+    std::vector<char> seen;
+    int64_t quantum, global_pass = 0;
+
+public:
+    StrideQueue(const std::vector<int64_t> & weights, const PolicyConfig & config)
+        : pass(weights.size(), 0)
+        , stride(weights.size())
+        , seen(weights.size(), 0)
+        , quantum(config.quantum)
+    {
+        for (size_t i = 0; i < weights.size(); i++)
+            stride[i] = std::max<int64_t>(1, stride1 / weights[i]);
+    }
+    void push(int i, int64_t, int64_t) override
+    {
+        if (!seen[i]) {
+            seen[i] = 1;
+            pass[i] = global_pass;
+        }
+        heap.push(pass[i], i);
+    }
+    int pop(int64_t) override
+    {
+        int i = heap.pop();
+        global_pass = pass[i];
+        return i;
+    }
+    int64_t slice(int, int64_t remaining, bool alone, int64_t until_arrival) override
+    {
+        return quantum_slice(quantum, remaining, alone, until_arrival);
+    }
+    void charge(int i, int64_t ran) override
+    {
+        // after k quanta alone, the process was last picked at the pass
+        // it had before the k-th one
+        int64_t quanta = ran / quantum + (ran % quantum != 0);
+        if (quanta > (std::numeric_limits<int64_t>::max() - pass[i]) / stride[i]) {
+            pass[i] = std::numeric_limits<int64_t>::max();
+            global_pass = pass[i];
+        } else {
+            global_pass = pass[i] + (quanta - 1) * stride[i];
+            pass[i] += quanta * stride[i];
+        }
+    }
+};
+
+std::unique_ptr<ReadyQueue> make_queue(const PolicyConfig & config, const std::vector<int64_t> & weights)
+{
+    int n = weights.size();
+    switch (config.policy) {
+    case Policy::FCFS: return std::make_unique<FcfsQueue>();
+    case Policy::SJF: return std::make_unique<ShortestQueue>(false);
+    case Policy::SRTF: return std::make_unique<ShortestQueue>(true);
+    case Policy::MLFQ: return std::make_unique<MlfqQueue>(n, config);
+    case Policy::Priority: return std::make_unique<AgingQueue>(weights, config);
+    case Policy::Lottery: return std::make_unique<LotteryQueue>(weights, config);
+    case Policy::Stride: return std::make_unique<StrideQueue>(weights, config);
+    // round-robin keeps the FIFO of simulate_sched()
+    default: return nullptr;
+    }
+}
+
+} // anonymous namespace
+
+bool parse_policy(const std::string & name, Policy & policy)
+{
+    static const std::pair<const char *, Policy> names[] = {
+        { "rr", Policy::RR }, { "fcfs", Policy::FCFS }, { "sjf", Policy::SJF },
+        { "srtf", Policy::SRTF }, { "mlfq", Policy::MLFQ }, { "priority", Policy::Priority },
+        { "lottery", Policy::Lottery }, { "stride", Policy::Stride },
+    };
+    for (auto & n : names)
+        if (name == n.first) {
+            policy = n.second;
+            return true;
+        }
+    return false;
+}
+
+// The event loop is the one of simulate_rr(), in scheduler.cpp, run with the
+// ready queue of the policy; round-robin has none, and keeps the loop's own.
+void simulate_policy(
+    const PolicyConfig & config,
+    int64_t max_seq_len,
+    std::vector<Process> & processes,
+    std::vector<int> & seq,
+    int64_t * switches)
+{
+    int n = processes.size();
+    std::vector<int64_t> weights = config.weights;
+    weights.resize(n, 1);
+    if (config.policy == Policy::Lottery || config.policy == Policy::Stride)
+        for (auto & w : weights)
+            w = std::max<int64_t>(w, 1);
+    std::unique_ptr<ReadyQueue> ready = make_queue(config, weights);
+
+    QueuePush push;
+    QueuePop pop;
+    QueueSlice slice;
+    QueueCharge charge;
+    if (ready) {
+        push = [&](int i, int64_t remaining, int64_t now) { ready->push(i, remaining, now); };
+        pop = [&](int64_t now) { return ready->pop(now); };
+        slice = [&](int i, int64_t remaining, bool alone, int64_t until_arrival) {
+            return ready->slice(i, remaining, alone, until_arrival);
+        };
+        charge = [&](int i, int64_t ran) { ready->charge(i, ran); };
+    }
+    simulate_sched(config.quantum, max_seq_len, processes, seq, switches, push, pop, slice, charge);
+}
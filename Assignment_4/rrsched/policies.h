@@ -0,0 +1,46 @@
+#pragma once
+#include "scheduler.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// scheduling policies simulate_policy() can run
+enum class Policy { RR, FCFS, SJF, SRTF, MLFQ, Priority, Lottery, Stride };
+
+/// parses a policy name as given on the command line ("rr", "fcfs", "sjf",
+/// "srtf", "mlfq", "priority", "lottery" or "stride"), returns false if the
+/// name is unknown
+bool parse_policy(const std::string & name, Policy & policy);
+
+/// a policy and its parameters
+struct PolicyConfig {
+    Policy policy = Policy::RR;
+    // time slice of RR, Priority, Lottery and Stride, and of the top MLFQ level
+    int64_t quantum = 1;
+    // MLFQ: number of levels, level l has a time slice of quantum << l
+    int mlfq_levels = 3;
+    // MLFQ: every mlfq_boost time units all processes go back to the top
+    // level, 0 = never
+    int64_t mlfq_boost = 0;
+    // Priority: waiting this long is worth one priority level, 0 = no aging
+    int64_t aging = 0;
+    // per process, its priority (Priority, lower runs first) or its number
+    // of tickets (Lottery and Stride); empty = all 1
+    std::vector<int64_t> weights;
+    // Lottery: seed of the random draws
+    uint64_t seed = 1;
+};
+
+/// runs the simulation of the configured policy, with the same inputs and
+/// outputs as simulate_rr(). If switches is not null, it is set to the
+/// number of context switches
+///
+/// every policy runs through simulate_sched(), the event loop of
+/// simulate_rr(), with its own ready queue; the queues are heaps, Fenwick
+/// trees or deques, so every scheduling decision costs O(log n) or less
+void simulate_policy(
+    const PolicyConfig & config,
+    int64_t max_seq_len,
+    std::vector<Process> & processes,
+    std::vector<int> & seq,
+    int64_t * switches = nullptr);
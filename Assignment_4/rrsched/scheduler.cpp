@@ -2,6 +2,11 @@
 
 #include "scheduler.h"
 #include "common.h"
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <utility>
 
 // this is the function you should implement
 //
@@ -19,17 +24,562 @@
 //         - adjust finish_time and start_time for each process
 //         - do not adjust other fields
 //
+namespace {
+
+// Fenwick tree counting the processes still in the ready queue, by position
+struct Fenwick {
+    std::vector<int> tree;
+    explicit Fenwick(int n)
+        : tree(n + 1, 0)
+    {
+        for (int i = 1; i <= n; i++) {
+            tree[i]++;
+            if (i + (i & -i) <= n)
+                tree[i + (i & -i)] += tree[i];
+        }
+    }
+    void remove(int pos)
+    {
+        for (int i = pos + 1; i < int(tree.size()); i += i & -i)
+            tree[i]--;
+    }
+    // number of entries at positions < pos
+    int count_before(int pos) const
+    {
+        int c = 0;
+        for (int i = pos; i > 0; i -= i & -i)
+            c += tree[i];
+        return c;
+    }
+};
+
+// FIFO of process indices in a ring buffer, whose size is a power of two
+// that doubles whenever it is full; unlike a deque, the entries are all in
+// one block, and an index costs 4 bytes
+class RingQueue {
+public:
+    int size() const { return count; }
+    bool empty() const { return count == 0; }
+    int32_t front() const { return buff[head]; }
+    // the entry at position pos from the front
+    int32_t operator[](int pos) const { return buff[(head + pos) & mask]; }
+    void push_back(int32_t i)
+    {
+        if (count == buff.size())
+            grow();
+        buff[(head + count++) & mask] = i;
+    }
+    void pop_front()
+    {
+        head = (head + 1) & mask;
+        count--;
+    }
+    void clear() { head = count = 0; }
+    void swap(RingQueue & other)
+    {
+        buff.swap(other.buff);
+        std::swap(mask, other.mask);
+        std::swap(head, other.head);
+        std::swap(count, other.count);
+    }
+
+private:
+    std::vector<int32_t> buff;
+    size_t mask = 0, head = 0, count = 0;
+
+    // out of line, so that push_back() stays small enough to inline
+    __attribute__((noinline)) void grow()
+    {
+        std::vector<int32_t> bigger(std::max<size_t>(16, 2 * buff.size()));
+        for (size_t pos = 0; pos < count; pos++)
+            bigger[pos] = (*this)[pos];
+        buff.swap(bigger);
+        mask = buff.size() - 1;
+        head = 0;
+    }
+};
+
+} // anonymous namespace
+
+// Event-driven simulation: time never advances by a single tick, only
+// straight to the next event, which is either the end of the running
+// process's time slice (quantum expiry or completion), or, while the CPU is
+// idle, the next arrival. A process alone in the system runs all of its
+// quanta up to the next arrival in one step.
+//
+// Once a whole round of the ready queue passes without an arrival or a
+// completion, the following rounds repeat it, with every process losing one
+// quantum per round. So as many whole rounds as possible are skipped at once:
+// k rounds, where k keeps every remaining burst positive and ends no later
+// than the next arrival. After the skip, an arrival or a completion is at
+// most one round away. So the cost is O(n log n) plus O(n) per arrival or
+// completion, no matter how many quanta the bursts span, plus up to
+// max_seq_len steps to fill seq[].
+//
+// Once seq[] is full, the completions themselves are computed rather than
+// simulated: in a stable queue, process j at position pos_j needing m_j more
+// quanta finishes in round m_j, so the processes finish in the order of
+// (m_j, pos_j). Process i then finishes at
+//   now + (bursts left of those finishing before it) + remaining[i]
+//       + quantum * ((m_i - 1) * (others left) + (others left before pos_i))
+// where a Fenwick tree counts the others left before pos_i. That is
+// O(log n) per completion instead of a whole round.
+//
+// Processes arriving during a time slice join the ready queue before the
+// preempted process is put back at its end, but those arriving at the very
+// moment the slice ends join it after that process.
+//
+// If switches is not null, it is set to the number of context switches,
+// the times the CPU went straight from one process to another, which is
+// counted in the skipped rounds and the computed completions too.
+//
+// If sink is set, it is given the whole execution sequence as it is
+// produced, with no cap: sink(ids, n, duration, times) means the n processes
+// ids[0 .. n) (-1 = idle) ran for duration each, one after the other, and
+// that repeated times times. A single run has n = 1 and times = 1, and
+// skipped rounds are a single call. The completions are then not computed,
+// as that skips the order of execution.
+//
+// The simulation only reads the processes, through procs, and returns the
+// start and finish times in start_time[] and finish_time[], so that
+// simulations with different quanta can share one copy of the processes,
+// and so that it can run on processes that are not in a vector<Process>.
+//
+// Inside, the processes are numbered in the order of arrival, and the fields
+// the main loop needs, the arrivals and the remaining bursts, are kept in
+// arrays of their own in that order, as are the start and finish times until
+// the end. The ready queue of round-robin is a ring buffer of those numbers.
+//
+// The same loop runs the other scheduling policies of simulate_sched(), with
+// their ready queue, which also sets the length of every time slice, in place
+// of round-robin's. Only round-robin's rounds are skipped and its completions
+// computed; the rest of the loop, the arrivals, the idle CPU, seq[], the sink
+// and the switches, is the same for every policy.
+namespace {
+
+// the processes of a vector<Process>
+struct ProcessView {
+    const std::vector<Process> & processes;
+    int size() const { return processes.size(); }
+    int64_t arrival(int i) const { return processes[i].arrival; }
+    int64_t burst(int i) const { return processes[i].burst; }
+    int id(int i) const { return processes[i].id; }
+};
+
+// processes given as (arrival, burst) pairs of int64_t, numbered from 0
+struct RecordView {
+    const int64_t * records;
+    size_t n;
+    int size() const { return n; }
+    int64_t arrival(int i) const { return records[2 * size_t(i)]; }
+    int64_t burst(int i) const { return records[2 * size_t(i) + 1]; }
+    int id(int i) const { return i; }
+};
+
+constexpr int64_t no_arrival = std::numeric_limits<int64_t>::max();
+
+// The ready queues of run_sched(), each of which also decides how long the
+// process it hands out may run. Besides start(), which gives it the input
+// index by_arrival[k] of process k, every queue has
+//   push(k, remaining, now)   queues process k, with remaining burst left
+//   pop(now)                  removes and returns the process to run next
+//   slice(k, remaining, alone, until_arrival)
+//                             how long process k may run from now on; alone
+//                             is set if no other process is ready, and
+//                             until_arrival is the time to the next arrival,
+//                             or no_arrival
+//   charge(k, ran)            process k left the CPU after running for ran
+// and rounds, which is set if it is round-robin's plain FIFO, whose repeated
+// rounds run_sched() can skip and whose completions it can compute.
+
+// round-robin: a FIFO, and time slices of one quantum
+struct RoundRobin {
+    static constexpr bool rounds = true;
+    int64_t quantum;
+    RingQueue fifo;
+
+    explicit RoundRobin(int64_t quantum)
+        : quantum(quantum)
+    {
+    }
+    void start(const std::vector<int> &) { }
+    bool empty() const { return fifo.empty(); }
+    void push(int k, int64_t, int64_t) { fifo.push_back(k); }
+    int pop(int64_t)
+    {
+        int k = fifo.front();
+        fifo.pop_front();
+        return k;
+    }
+    int64_t slice(int, int64_t remaining, bool alone, int64_t until_arrival) const
+    {
+        if (!alone)
+            return std::min(quantum, remaining);
+        // nobody to switch to: the process keeps the CPU for whole quanta,
+        // until the first quantum boundary after the next arrival
+        if (until_arrival == no_arrival)
+            return remaining;
+        int64_t k = until_arrival / quantum + 1;
+        return k <= remaining / quantum ? k * quantum : remaining;
+    }
+    void charge(int, int64_t) { }
+};
+
+// the queue of another policy, given as functions of the input indices
+struct PolicyQueue {
+    static constexpr bool rounds = false;
+    const std::function<void(int, int64_t, int64_t)> & push_fn;
+    const std::function<int(int64_t)> & pop_fn;
+    const std::function<int64_t(int, int64_t, bool, int64_t)> & slice_fn;
+    const std::function<void(int, int64_t)> & charge_fn;
+    const std::vector<int> * by_arrival = nullptr;
+    std::vector<int> rank;    // rank[by_arrival[k]] = k
+    int count = 0;
+
+    void start(const std::vector<int> & order)
+    {
+        by_arrival = &order;
+        rank.resize(order.size());
+        for (size_t k = 0; k < order.size(); k++)
+            rank[order[k]] = k;
+    }
+    bool empty() const { return count == 0; }
+    void push(int k, int64_t remaining, int64_t now)
+    {
+        push_fn((*by_arrival)[k], remaining, now);
+        count++;
+    }
+    int pop(int64_t now)
+    {
+        count--;
+        return rank[pop_fn(now)];
+    }
+    int64_t slice(int k, int64_t remaining, bool alone, int64_t until_arrival) const
+    {
+        return slice_fn((*by_arrival)[k], remaining, alone, until_arrival);
+    }
+    void charge(int k, int64_t ran)
+    {
+        if (charge_fn)
+            charge_fn((*by_arrival)[k], ran);
+    }
+};
+
+template <typename Procs, typename Queue>
+void run_sched(
+    Queue & ready,
+    int64_t max_seq_len,
+    const Procs & procs,
+    std::vector<int64_t> & start_time,
+    std::vector<int64_t> & finish_time,
+    std::vector<int> & seq,
+    int64_t * switches,
+    const std::function<void(const int *, int, int64_t, int64_t)> & sink
+) {
+    seq.clear();
+    int n = procs.size();
+    start_time.assign(n, -1);
+    finish_time.assign(n, -1);
+
+    // indices of processes by arrival, ties broken by input order, and
+    // their arrivals; traces are usually in order already, which is checked
+    // in a single pass, and otherwise (arrival, index) pairs are sorted, so
+    // that the comparisons do not chase indices into the processes
+    std::vector<int> by_arrival(n);
+    std::vector<int64_t> arrivals(n);
+    bool in_order = true;
+    for (int i = 0; i < n; i++) {
+        arrivals[i] = procs.arrival(i);
+        in_order = in_order && (i == 0 || arrivals[i - 1] <= arrivals[i]);
+    }
+    if (in_order) {
+        std::iota(by_arrival.begin(), by_arrival.end(), 0);
+    } else {
+        std::vector<std::pair<int64_t, int>> order(n);
+        for (int i = 0; i < n; i++)
+            order[i] = { arrivals[i], i };
+        std::sort(order.begin(), order.end());
+        for (int k = 0; k < n; k++) {
+            arrivals[k] = order[k].first;
+            by_arrival[k] = order[k].second;
+        }
+    }
+
+    // from here on, processes are numbered by arrival, so that the ready
+    // queue, which is mostly in the order of arrival, walks these arrays
+    // front to back; the results are put back in input order at the end
+    std::vector<int64_t> remaining(n);
+    for (int k = 0; k < n; k++) {
+        remaining[k] = procs.burst(by_arrival[k]);
+    }
+    auto id_of = [&](int k) { return procs.id(by_arrival[k]); };
+    ready.start(by_arrival);
+
+    // appends id to the compressed sequence, up to max_seq_len entries
+    auto append = [&](int id) {
+        if (int64_t(seq.size()) < max_seq_len && (seq.empty() || seq.back() != id))
+            seq.push_back(id);
+    };
+    // appends id, which ran for duration, to seq[] and the sink
+    auto emit = [&](int id, int64_t duration) {
+        append(id);
+        if (sink)
+            sink(&id, 1, duration, 1);
+    };
+    // what ran last, -1 = the CPU idled
+    int last_run = -1;
+    int64_t n_switches = 0;
+    auto record = [&](int id, int64_t duration) {
+        n_switches += id >= 0 && last_run >= 0 && id != last_run;
+        last_run = id;
+        emit(id, duration);
+    };
+
+    int next_arrival = 0;
+    int64_t curr_time = 0;
+    // moves every process that arrived before curr_time (or at curr_time,
+    // if inclusive is set) into the ready queue
+    auto admit = [&](bool inclusive) {
+        while (next_arrival < n) {
+            int64_t arrival = arrivals[next_arrival];
+            if (arrival > curr_time || (arrival == curr_time && !inclusive))
+                break;
+            ready.push(next_arrival, remaining[next_arrival], curr_time);
+            next_arrival++;
+        }
+    };
+
+    // the queue of round-robin rebuilt after computed completions
+    RingQueue rest;
+    // time slices since the last arrival or completion
+    int64_t quiet = 0;
+    // the ids of a skipped round, for the sink
+    std::vector<int> round;
+    while (next_arrival < n || !ready.empty()) {
+        if constexpr (Queue::rounds) {
+            RingQueue & fifo = ready.fifo;
+            const int64_t quantum = ready.quantum;
+            int64_t n_ready = fifo.size();
+            if (n_ready >= 2 && quiet >= n_ready && int64_t(seq.size()) >= max_seq_len && !sink) {
+                // the last round only changed the remaining bursts, and the order
+                // of execution no longer matters: finish processes until the next
+                // arrival straight away
+                bool has_arrival = next_arrival < n;
+                int64_t arrival = has_arrival ? arrivals[next_arrival] : 0;
+                std::vector<int64_t> rounds(n_ready);
+                std::vector<int> order(n_ready);
+                for (int pos = 0; pos < n_ready; pos++) {
+                    rounds[pos] = (remaining[fifo[pos]] - 1) / quantum + 1;
+                    order[pos] = pos;
+                }
+                std::sort(order.begin(), order.end(), [&](int a, int b) {
+                    return rounds[a] < rounds[b] || (rounds[a] == rounds[b] && a < b);
+                });
+                Fenwick left(n_ready);
+                int64_t finished_bursts = 0, n_left = n_ready;
+                // time slices until the last completion, and the completion before it
+                int64_t slices = 0, before_last = curr_time;
+                int last = -1;
+                for (int pos : order) {
+                    int j = fifo[pos];
+                    int64_t finish = curr_time + finished_bursts + remaining[j]
+                        + (rounds[pos] - 1) * quantum * (n_left - 1)
+                        + quantum * left.count_before(pos);
+                    if (has_arrival && finish > arrival)
+                        break;
+                    if (last >= 0)
+                        before_last = finish_time[fifo[last]];
+                    slices += rounds[pos];
+                    finish_time[j] = finish;
+                    finished_bursts += remaining[j];
+                    left.remove(pos);
+                    n_left--;
+                    last = pos;
+                }
+                if (last >= 0) {
+                    // rebuild the queue as of the last completion: it continues
+                    // after that process, and those before it ran one more round
+                    int64_t time = finish_time[fifo[last]];
+                    int64_t served = (rounds[last] - 1) * quantum;
+                    rest.clear();
+                    for (int k = 1; k < n_ready; k++) {
+                        int pos = (last + k) % n_ready;
+                        int j = fifo[pos];
+                        if (finish_time[j] >= 0)
+                            continue;
+                        remaining[j] -= served + (pos < last ? quantum : 0);
+                        slices += rounds[last] - 1 + (pos < last);
+                        rest.push_back(j);
+                    }
+                    // every slice is a switch, except when the last process ran
+                    // alone after the one before it finished
+                    if (n_left == 0)
+                        slices -= (time - before_last - 1) / quantum;
+                    n_switches += slices;
+                    last_run = id_of(fifo[last]);
+                    fifo.swap(rest);
+                    curr_time = time;
+                    admit(true);
+                    n_ready = fifo.size();
+                    quiet = 0;
+                }
+            }
+            if (n_ready >= 2 && quiet >= n_ready) {
+                // the last round only changed the remaining bursts, skip ahead
+                int64_t min_remaining = remaining[fifo.front()];
+                for (int pos = 1; pos < n_ready; pos++)
+                    min_remaining = std::min(min_remaining, remaining[fifo[pos]]);
+                int64_t k = (min_remaining - 1) / quantum;
+                if (next_arrival < n) {
+                    int64_t arrival = arrivals[next_arrival];
+                    k = std::min(k, (arrival - curr_time) / quantum / n_ready);
+                }
+                if (k > 0) {
+                    for (int64_t r = 0; r < k && int64_t(seq.size()) < max_seq_len; r++)
+                        for (int pos = 0; pos < n_ready; pos++)
+                            append(id_of(fifo[pos]));
+                    if (sink) {
+                        round.clear();
+                        for (int pos = 0; pos < n_ready; pos++)
+                            round.push_back(id_of(fifo[pos]));
+                        sink(round.data(), n_ready, quantum, k);
+                    }
+                    n_switches += k * n_ready;
+                    for (int pos = 0; pos < n_ready; pos++)
+                        remaining[fifo[pos]] -= k * quantum;
+                    curr_time += k * quantum * n_ready;
+                    admit(true);
+                }
+                quiet = 0;
+            }
+
+        }
+
+        if (ready.empty()) {
+            // the computed completions may have finished everything
+            if (next_arrival == n)
+                break;
+            // the CPU idles until the next arrival, in one step
+            int64_t arrival = arrivals[next_arrival];
+            if (curr_time < arrival) {
+                record(-1, arrival - curr_time);
+                curr_time = arrival;
+            }
+            admit(true);
+            continue;
+        }
+
+        int i = ready.pop(curr_time);
+        if (start_time[i] < 0)
+            start_time[i] = curr_time;
+        int64_t until_arrival = next_arrival < n ? arrivals[next_arrival] - curr_time : no_arrival;
+        int64_t slice = ready.slice(i, remaining[i], ready.empty(), until_arrival);
+        record(id_of(i), slice);
+        curr_time += slice;
+        remaining[i] -= slice;
+        ready.charge(i, slice);
+        int arrived = next_arrival;
+        admit(false);
+        if (remaining[i] == 0)
+            finish_time[i] = curr_time;
+        else
+            ready.push(i, remaining[i], curr_time);
+        admit(true);
+        quiet = (remaining[i] == 0 || next_arrival != arrived) ? 0 : quiet + 1;
+    }
+    if (!in_order) {
+        // back to input order
+        std::vector<int64_t> by_rank;
+        for (auto times : { &start_time, &finish_time }) {
+            by_rank.swap(*times);
+            times->resize(n);
+            for (int k = 0; k < n; k++)
+                (*times)[by_arrival[k]] = by_rank[k];
+        }
+    }
+    if (switches)
+        *switches = n_switches;
+}
+
+} // anonymous namespace
+
+void simulate_rr(
+    int64_t quantum,
+    int64_t max_seq_len,
+    const std::vector<Process> & processes,
+    std::vector<int64_t> & start_time,
+    std::vector<int64_t> & finish_time,
+    std::vector<int> & seq,
+    int64_t * switches,
+    const std::function<void(const int *, int, int64_t, int64_t)> & sink
+) {
+    RoundRobin ready(quantum);
+    run_sched(ready, max_seq_len, ProcessView { processes }, start_time, finish_time, seq,
+        switches, sink);
+}
+
 void simulate_rr(
-    int64_t quantum, 
+    int64_t quantum,
+    int64_t max_seq_len,
+    const int64_t * records,
+    size_t n,
+    std::vector<int64_t> & start_time,
+    std::vector<int64_t> & finish_time,
+    std::vector<int> & seq,
+    int64_t * switches,
+    const std::function<void(const int *, int, int64_t, int64_t)> & sink
+) {
+    RoundRobin ready(quantum);
+    run_sched(ready, max_seq_len, RecordView { records, n }, start_time, finish_time, seq,
+        switches, sink);
+}
+
+void simulate_rr(
+    int64_t quantum,
     int64_t max_seq_len,
     std::vector<Process> & processes,
-    std::vector<int> & seq
+    std::vector<int> & seq,
+    int64_t * switches,
+    const std::function<void(const int *, int, int64_t, int64_t)> & sink
 ) {
-    // replace the wrong implementation below with your own!!!!
-    seq.clear();
-    for (auto & p : processes) {
-        p.finish_time = p.arrival + p.burst;
-        p.start_time = p.arrival;
-        seq.push_back(p.id);
+    std::vector<int64_t> start_time, finish_time;
+    simulate_rr(quantum, max_seq_len, processes, start_time, finish_time, seq, switches, sink);
+    for (size_t i = 0; i < processes.size(); i++) {
+        processes[i].start_time = start_time[i];
+        processes[i].finish_time = finish_time[i];
+    }
+}
+
+void simulate_sched(
+    int64_t quantum,
+    int64_t max_seq_len,
+    std::vector<Process> & processes,
+    std::vector<int> & seq,
+    int64_t * switches,
+    const std::function<void(int, int64_t, int64_t)> & push,
+    const std::function<int(int64_t)> & pop,
+    const std::function<int64_t(int, int64_t, bool, int64_t)> & slice,
+    const std::function<void(int, int64_t)> & charge
+) {
+    if (!push) {
+        simulate_rr(quantum, max_seq_len, processes, seq, switches, nullptr);
+        return;
+    }
+    std::vector<int64_t> start_time, finish_time;
+    PolicyQueue ready { push, pop, slice, charge };
+    run_sched(ready, max_seq_len, ProcessView { processes }, start_time, finish_time, seq,
+        switches, nullptr);
+    for (size_t i = 0; i < processes.size(); i++) {
+        processes[i].start_time = start_time[i];
+        processes[i].finish_time = finish_time[i];
     }
 }
+
+void simulate_rr(
+    int64_t quantum,
+    int64_t max_seq_len,
+    std::vector<Process> & processes,
+    std::vector<int> & seq
+) {
+    simulate_rr(quantum, max_seq_len, processes, seq, nullptr, nullptr);
+}
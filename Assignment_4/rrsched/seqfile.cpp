@@ -0,0 +1,169 @@
+#include "seqfile.h"
+#include "common.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace {
+
+const char magic[8] = { 'R', 'R', 'S', 'E', 'Q', '0', '0', '1' };
+
+// size of the output buffer, which is written out when it gets this full
+constexpr size_t buff_size = 1 << 16;
+
+} // anonymous namespace
+
+SeqWriter::SeqWriter(const std::string & path)
+    : path(path)
+{
+    out = fopen(path.c_str(), "wb");
+    if (!out)
+        throw fatal_error() << "cannot create " << path << ": " << strerror(errno);
+    // room for one more record, of up to four varints of 10 bytes each
+    buff.reserve(buff_size + 4 * 10);
+    buff.insert(buff.end(), magic, magic + sizeof(magic));
+}
+
+SeqWriter::~SeqWriter()
+{
+    if (!out)
+        return;
+    try {
+        close();
+    } catch (...) {
+    }
+}
+
+void SeqWriter::add(const int * ids, int n, int64_t duration, int64_t times)
+{
+    if (n <= 0 || duration <= 0 || times <= 0)
+        return;
+    if (n == 1) {
+        add_run(ids[0], duration * times);
+        return;
+    }
+    // a repeat stands for the last n runs, so the round is written out
+    // once, or twice if its first run merged with the one before it, and
+    // the rest becomes a repeat; a round whose runs would merge with each
+    // other, or with the next round, is written out every time
+    bool repeatable = ids[0] != ids[n - 1];
+    for (int j = 1; j < n; j++)
+        repeatable = repeatable && ids[j] != ids[j - 1];
+    bool merges = last_duration > 0 && last_id == ids[0];
+    int64_t in_full = repeatable ? std::min<int64_t>(times, merges ? 2 : 1) : times;
+    for (int64_t r = 0; r < in_full; r++)
+        for (int j = 0; j < n; j++)
+            add_run(ids[j], duration);
+    if (in_full < times) {
+        end_run();
+        put(0);
+        put(n);
+        put(times - in_full);
+        put(n * duration);
+        n_runs += n * (times - in_full);
+        if (buff.size() >= buff_size)
+            flush();
+    }
+}
+
+void SeqWriter::add_run(int id, int64_t duration)
+{
+    if (last_duration > 0 && id == last_id) {
+        last_duration += duration;
+        return;
+    }
+    end_run();
+    last_id = id;
+    last_duration = duration;
+    n_runs++;
+}
+
+// writes out the run not written yet, if any
+void SeqWriter::end_run()
+{
+    if (last_duration == 0)
+        return;
+    put(uint64_t(last_id) + 2);
+    put(last_duration);
+    last_duration = 0;
+    if (buff.size() >= buff_size)
+        flush();
+}
+
+void SeqWriter::close()
+{
+    if (!out)
+        return;
+    try {
+        end_run();
+        flush();
+    } catch (...) {
+        fclose(out);
+        out = nullptr;
+        throw;
+    }
+    int err = fclose(out) != 0 ? errno : 0;
+    out = nullptr;
+    if (err)
+        throw fatal_error() << "cannot write " << path << ": " << strerror(err);
+}
+
+// LEB128: 7 bits at a time, low bits first, the top bit set on all bytes
+// but the last
+void SeqWriter::put(uint64_t value)
+{
+    while (value >= 0x80) {
+        buff.push_back(uint8_t(value) | 0x80);
+        value >>= 7;
+    }
+    buff.push_back(uint8_t(value));
+}
+
+void SeqWriter::flush()
+{
+    if (fwrite(buff.data(), 1, buff.size(), out) != buff.size())
+        throw fatal_error() << "cannot write " << path << ": " << strerror(errno);
+    buff.clear();
+}
+
+void read_seq(
+    FILE * in,
+    const std::function<void(int id, int64_t duration)> & run,
+    const std::function<void(int64_t m, int64_t times, int64_t period)> & repeat)
+{
+    char header[sizeof(magic)];
+    if (fread(header, 1, sizeof(header), in) != sizeof(header)
+        || memcmp(header, magic, sizeof(magic)) != 0)
+        throw fatal_error() << "not a sequence file";
+
+    std::vector<uint8_t> buff(buff_size);
+    // the varints of the record being read, and the one being read
+    uint64_t fields[4];
+    int n_fields = 0;
+    uint64_t value = 0;
+    int shift = 0;
+    while (size_t len = fread(buff.data(), 1, buff.size(), in)) {
+        for (size_t k = 0; k < len; k++) {
+            if (shift > 63)
+                throw fatal_error() << "corrupt sequence file";
+            value |= uint64_t(buff[k] & 0x7f) << shift;
+            shift += 7;
+            if (buff[k] & 0x80)
+                continue;
+            fields[n_fields++] = value;
+            value = 0;
+            shift = 0;
+            if (fields[0] != 0 && n_fields == 2) {
+                run(int(int64_t(fields[0]) - 2), fields[1]);
+                n_fields = 0;
+            } else if (fields[0] == 0 && n_fields == 4) {
+                repeat(fields[1], fields[2], fields[3]);
+                n_fields = 0;
+            }
+        }
+    }
+    if (ferror(in))
+        throw fatal_error() << "cannot read the sequence file: " << strerror(errno);
+    if (n_fields > 0 || shift > 0)
+        throw fatal_error() << "truncated sequence file";
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+/// Execution sequence files: the 8 bytes "RRSEQ001", followed by records of
+/// unsigned LEB128 varints, each either
+///   - a run: the id + 2 (1 = idle), and the time it ran for, or
+///   - a repeat: 0, m, times, and period: the last m runs, which took
+///     period, repeat times more times.
+/// The first run starts at time 0. Consecutive runs have different ids, so
+/// the ids of the expanded runs are the compressed sequence of
+/// simulate_rr().
+///
+/// writes the records to a file, or to anything that can be opened for
+/// writing by name, such as a pipe, in order, through a fixed-size buffer,
+/// so the memory used does not depend on the length of the sequence
+class SeqWriter {
+public:
+    /// throws fatal_error if path cannot be opened
+    explicit SeqWriter(const std::string & path);
+    /// writes out what is left, without reporting errors; call close() to
+    /// see them
+    ~SeqWriter();
+    SeqWriter(const SeqWriter &) = delete;
+    SeqWriter & operator=(const SeqWriter &) = delete;
+
+    /// the processes ids[0 .. n) ran for duration each, one after the
+    /// other, times times, as given to a SeqSink; a run of the same id as
+    /// the last one is merged with it, and a repeated round becomes a repeat
+    /// record; throws fatal_error if the file cannot be written
+    void add(const int * ids, int n, int64_t duration, int64_t times);
+    /// writes out the last run and closes the file, throws fatal_error if
+    /// that fails
+    void close();
+    /// number of runs added so far, with the repeated ones
+    int64_t runs() const { return n_runs; }
+
+private:
+    FILE * out = nullptr;
+    std::string path;
+    std::vector<uint8_t> buff;
+    // the run not written yet, which the next one may extend
+    int last_id = 0;
+    int64_t last_duration = 0;
+    int64_t n_runs = 0;
+
+    void add_run(int id, int64_t duration);
+    void end_run();
+    void put(uint64_t value);
+    void flush();
+};
+
+/// reads the records of a sequence file from in, in order, calling
+/// run(id, duration) for each run, and repeat(m, times, period) for each
+/// repeat; throws fatal_error if in is not a sequence file or ends in the
+/// middle of a record
+void read_seq(
+    FILE * in,
+    const std::function<void(int id, int64_t duration)> & run,
+    const std::function<void(int64_t m, int64_t times, int64_t period)> & repeat);
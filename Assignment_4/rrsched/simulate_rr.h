@@ -0,0 +1,81 @@
+#pragma once
+#include "scheduler.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/// The simulate_rr() overloads beyond the one of scheduler.h, which is not
+/// to be edited. They are defined in scheduler.cpp, which only includes
+/// scheduler.h so that it builds on its own, and spells SeqSink out.
+
+/// receives the whole execution sequence of simulate_rr() as it is
+/// produced: the processes ids[0 .. n) (-1 = idle) ran for duration time
+/// units each, one after the other, and all of that repeated times times;
+/// consecutive runs may have the same id
+using SeqSink = std::function<void(const int * ids, int n, int64_t duration, int64_t times)>;
+
+/// simulate_rr() that also sets switches, if not null, to the number of
+/// context switches, the times the CPU went straight from one process to
+/// another, and passes the execution sequence to sink, if set, besides seq
+void simulate_rr(
+    int64_t quantum,
+    int64_t max_seq_len,
+    std::vector<Process> & processes,
+    std::vector<int> & seq,
+    int64_t * switches,
+    const SeqSink & sink = nullptr);
+
+/// the same, but only reading processes, and returning their start and
+/// finish times in start_time and finish_time instead
+void simulate_rr(
+    int64_t quantum,
+    int64_t max_seq_len,
+    const std::vector<Process> & processes,
+    std::vector<int64_t> & start_time,
+    std::vector<int64_t> & finish_time,
+    std::vector<int> & seq,
+    int64_t * switches,
+    const SeqSink & sink = nullptr);
+
+/// simulate_rr() on n processes given as (arrival, burst) pairs in
+/// records[0 .. 2n), such as the records of a TraceFile, with process i
+/// getting id i
+void simulate_rr(
+    int64_t quantum,
+    int64_t max_seq_len,
+    const int64_t * records,
+    size_t n,
+    std::vector<int64_t> & start_time,
+    std::vector<int64_t> & finish_time,
+    std::vector<int> & seq,
+    int64_t * switches,
+    const SeqSink & sink = nullptr);
+
+/// the ready queue of a scheduling policy for simulate_sched(), as functions
+/// of the indices of the processes:
+///   push(i, remaining, now) queues process i, with remaining burst left
+///   pop(now) removes and returns the process to run next
+///   slice(i, remaining, alone, until_arrival) is how long process i may run
+///     from now on; alone is set if no other process is ready, and
+///     until_arrival is the time to the next arrival, INT64_MAX if none
+///   charge(i, ran) is called when process i leaves the CPU after running
+///     for ran, and may be empty
+using QueuePush = std::function<void(int i, int64_t remaining, int64_t now)>;
+using QueuePop = std::function<int(int64_t now)>;
+using QueueSlice = std::function<int64_t(int i, int64_t remaining, bool alone, int64_t until_arrival)>;
+using QueueCharge = std::function<void(int i, int64_t ran)>;
+
+/// runs the event loop of simulate_rr() with the ready queue of another
+/// policy, with the same outputs; without push, it is simulate_rr() itself,
+/// with time slices of quantum
+void simulate_sched(
+    int64_t quantum,
+    int64_t max_seq_len,
+    std::vector<Process> & processes,
+    std::vector<int> & seq,
+    int64_t * switches,
+    const QueuePush & push,
+    const QueuePop & pop,
+    const QueueSlice & slice,
+    const QueueCharge & charge);
@@ -0,0 +1,70 @@
+#include "sweep.h"
+#include "simulate_rr.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <thread>
+
+bool parse_sweep(const std::string & text, SweepRange & range)
+{
+    // the fields between the colons, which must all be whole numbers
+    std::vector<int64_t> fields;
+    size_t begin = 0;
+    while (true) {
+        size_t end = std::min(text.find(':', begin), text.size());
+        std::string tok = text.substr(begin, end - begin);
+        // stoll() would skip leading spaces
+        if (tok.empty() || std::isspace((unsigned char) tok[0]))
+            return false;
+        size_t pos = 0;
+        try {
+            fields.push_back(std::stoll(tok, &pos));
+        } catch (...) {
+            return false;
+        }
+        if (pos != tok.size())
+            return false;
+        if (end == text.size())
+            break;
+        begin = end + 1;
+    }
+    if (fields.size() != 2 && fields.size() != 3)
+        return false;
+    range.first = fields[0];
+    range.last = fields[1];
+    range.step = fields.size() == 3 ? fields[2] : 1;
+    return range.first > 0 && range.last >= range.first && range.step > 0;
+}
+
+// A pool of n_threads workers, which take the next quantum from a shared
+// counter until there is none left, so that quick runs (large quanta) and
+// slow ones balance out. Every run writes its own slot of the results.
+std::vector<Metrics> sweep_rr(
+    const std::vector<Process> & processes,
+    const SweepRange & range,
+    int n_threads)
+{
+    size_t n_runs = range.size();
+    std::vector<Metrics> results(n_runs);
+    std::atomic<size_t> next { 0 };
+
+    auto worker = [&]() {
+        std::vector<int64_t> start_time, finish_time;
+        std::vector<int> seq;
+        for (size_t i = next++; i < n_runs; i = next++) {
+            int64_t switches = 0;
+            // nothing of seq is printed, so none of it is kept
+            simulate_rr(range.quantum(i), 0, processes, start_time, finish_time, seq, &switches);
+            results[i] = compute_metrics(processes, start_time, finish_time, switches);
+        }
+    };
+
+    n_threads = std::max(1, std::min<int>(n_threads, n_runs));
+    std::vector<std::thread> threads;
+    for (int t = 1; t < n_threads; t++)
+        threads.emplace_back(worker);
+    worker();
+    for (auto & t : threads)
+        t.join();
+    return results;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "metrics.h"
+#include "scheduler.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// the quanta first, first + step, ... up to last
+struct SweepRange {
+    int64_t first = 1, last = 1, step = 1;
+    size_t size() const { return (last - first) / step + 1; }
+    int64_t quantum(size_t i) const { return first + int64_t(i) * step; }
+};
+
+/// parses "first:last" or "first:last:step", returns false if it is not
+/// a valid range of positive quanta
+bool parse_sweep(const std::string & text, SweepRange & range);
+
+/// runs simulate_rr() with every quantum of the range, and returns the
+/// metrics of each run, in the order of the quanta
+///
+/// the runs are spread over n_threads threads, which all read the same
+/// processes; each thread only has its own start and finish times, and
+/// reuses them from one run to the next
+std::vector<Metrics> sweep_rr(
+    const std::vector<Process> & processes,
+    const SweepRange & range,
+    int n_threads);
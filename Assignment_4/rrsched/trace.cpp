@@ -0,0 +1,154 @@
+#include "trace.h"
+#include "common.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char magic[8] = { 'R', 'R', 'T', 'R', 'A', 'C', 'E', '1' };
+
+} // anonymous namespace
+
+TraceFile::TraceFile(const std::string & path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw fatal_error() << "cannot open " << path << ": " << strerror(errno);
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int err = errno;
+        close(fd);
+        throw fatal_error() << "cannot stat " << path << ": " << strerror(err);
+    }
+    map_size = st.st_size;
+    if (map_size < sizeof(magic) || (map_size - sizeof(magic)) % (2 * sizeof(int64_t)) != 0) {
+        close(fd);
+        throw fatal_error() << path << " is not a trace file";
+    }
+    map = mmap(nullptr, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int err = errno;
+    // the mapping stays valid without the descriptor
+    close(fd);
+    if (map == MAP_FAILED) {
+        map = nullptr;
+        throw fatal_error() << "cannot map " << path << ": " << strerror(err);
+    }
+    if (memcmp(map, magic, sizeof(magic)) != 0) {
+        munmap(map, map_size);
+        map = nullptr;
+        throw fatal_error() << path << " is not a trace file";
+    }
+    // start reading the whole file in ahead of the simulation
+    madvise(map, map_size, MADV_WILLNEED);
+    data = reinterpret_cast<const int64_t *>(static_cast<const char *>(map) + sizeof(magic));
+    n = (map_size - sizeof(magic)) / (2 * sizeof(int64_t));
+}
+
+TraceFile::~TraceFile()
+{
+    if (map)
+        munmap(map, map_size);
+}
+
+std::vector<Process> TraceFile::processes() const
+{
+    std::vector<Process> processes(n);
+    for (size_t i = 0; i < n; i++) {
+        processes[i].id = i;
+        processes[i].arrival = arrival(i);
+        processes[i].burst = burst(i);
+    }
+    return processes;
+}
+
+// Parses the input in large blocks, a character at a time, rather than line
+// by line into strings, and writes the records out in large blocks too.
+size_t convert_trace(FILE * in, const std::string & path)
+{
+    FILE * out = fopen(path.c_str(), "wb");
+    if (!out)
+        throw fatal_error() << "cannot create " << path << ": " << strerror(errno);
+    std::vector<int64_t> records;
+    size_t n = 0;
+    auto flush = [&]() {
+        if (fwrite(records.data(), sizeof(int64_t), records.size(), out) != records.size())
+            throw fatal_error() << "cannot write " << path << ": " << strerror(errno);
+        records.clear();
+    };
+
+    try {
+        if (fwrite(magic, 1, sizeof(magic), out) != sizeof(magic))
+            throw fatal_error() << "cannot write " << path << ": " << strerror(errno);
+
+        std::vector<char> buff(1 << 20);
+        // the ints of the current line, and the one being parsed
+        int64_t toks[3];
+        int n_toks = 0;
+        int64_t value = 0;
+        bool in_number = false, negative = false, has_digits = false;
+        int64_t line_no = 1;
+        auto end_number = [&]() {
+            if (!has_digits)
+                throw fatal_error() << "Error on line " << line_no << ": not an int";
+            if (n_toks == 3)
+                throw fatal_error() << "Error on line " << line_no << ": need 2 or 3 ints per line";
+            toks[n_toks++] = negative ? -value : value;
+            in_number = negative = has_digits = false;
+            value = 0;
+        };
+        auto end_line = [&]() {
+            if (in_number)
+                end_number();
+            if (n_toks == 1)
+                throw fatal_error() << "Error on line " << line_no << ": need 2 or 3 ints per line";
+            if (n_toks > 0) {
+                // the weight, if any, is dropped
+                records.push_back(toks[0]);
+                records.push_back(toks[1]);
+                n++;
+                if (records.size() >= (1 << 16))
+                    flush();
+            }
+            n_toks = 0;
+            line_no++;
+        };
+
+        while (size_t len = fread(buff.data(), 1, buff.size(), in)) {
+            for (size_t k = 0; k < len; k++) {
+                char c = buff[k];
+                if (c >= '0' && c <= '9') {
+                    if (value > (INT64_MAX - (c - '0')) / 10)
+                        throw fatal_error() << "Error on line " << line_no << ": int too large";
+                    value = value * 10 + (c - '0');
+                    in_number = has_digits = true;
+                } else if ((c == '-' || c == '+') && !in_number) {
+                    in_number = true;
+                    negative = c == '-';
+                } else if (c == '\n') {
+                    end_line();
+                } else if (c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f') {
+                    if (in_number)
+                        end_number();
+                } else {
+                    throw fatal_error() << "Error on line " << line_no << ": not an int";
+                }
+            }
+        }
+        if (ferror(in))
+            throw fatal_error() << "cannot read the input: " << strerror(errno);
+        end_line();
+        flush();
+    } catch (...) {
+        // no half-written trace is left behind
+        fclose(out);
+        remove(path.c_str());
+        throw;
+    }
+    if (fclose(out) != 0)
+        throw fatal_error() << "cannot write " << path << ": " << strerror(errno);
+    return n;
+}
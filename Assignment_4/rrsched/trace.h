@@ -0,0 +1,44 @@
+#pragma once
+#include "scheduler.h"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/// Binary trace files of processes: the 8 bytes "RRTRACE1", followed by
+/// one 16-byte record per process, its arrival and its burst as int64_t in
+/// the byte order of the machine. Process i is the i-th record, and gets
+/// id i. The weights of the text format are not kept.
+///
+/// A trace is read by mapping it into memory, so loading it costs nothing
+/// up front, and the simulation reads the records straight from the file.
+class TraceFile {
+public:
+    /// maps the trace at path, throws fatal_error if it cannot be read or
+    /// is not a trace
+    explicit TraceFile(const std::string & path);
+    ~TraceFile();
+    TraceFile(const TraceFile &) = delete;
+    TraceFile & operator=(const TraceFile &) = delete;
+
+    /// number of processes
+    size_t size() const { return n; }
+    /// the (arrival, burst) pairs of the processes, 2 * size() values
+    const int64_t * records() const { return data; }
+    int64_t arrival(size_t i) const { return data[2 * i]; }
+    int64_t burst(size_t i) const { return data[2 * i + 1]; }
+
+    /// the processes as a vector, for the simulations that need one
+    std::vector<Process> processes() const;
+
+private:
+    void * map = nullptr;
+    size_t map_size = 0;
+    const int64_t * data = nullptr;
+    size_t n = 0;
+};
+
+/// converts the text format, lines of 'arrival burst [weight]', read from
+/// in, into a trace file at path, and returns the number of processes;
+/// throws fatal_error, with the line number, on a malformed line
+size_t convert_trace(FILE * in, const std::string & path);